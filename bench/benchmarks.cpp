@@ -0,0 +1,478 @@
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+#include "npc.h"
+#include "proximity.h"
+#include "factory.h"
+#include "world.h"
+#include "spatial_index.h"
+#include "flow_field.h"
+#include "kind_registry.h"
+#include "observer.h"
+#include "simulation.h"
+#include "world_gen.h"
+#include "dice.h"
+#include "locality.h"
+#include "event_log.h"
+
+// Простые микробенчмарки без внешних зависимостей: ./benchmarks [фильтр по имени]
+
+namespace {
+    using Clock = std::chrono::steady_clock;
+
+    volatile size_t sink = 0;
+
+    // Лучшее время из нескольких прогонов, в миллисекундах
+    double measure_ms(const std::function<size_t()> &fn, int repeats = 5) {
+        double best = 1e300;
+        for (int r = 0; r < repeats; ++r) {
+            auto start = Clock::now();
+            sink = sink + fn();
+            double ms = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+            best = std::min(best, ms);
+        }
+        return best;
+    }
+
+    // baseline_ms 0 - сравнивать не с чем (замер сравнивается между сборками, см. bench/pgo.sh)
+    void report(const std::string &name, double baseline_ms, double ms) {
+        std::cout << std::left << std::setw(40) << name
+                  << std::right << std::fixed << std::setprecision(3);
+        if (baseline_ms > 0) {
+            std::cout << std::setw(12) << baseline_ms << " ms";
+        } else {
+            std::cout << std::setw(15) << "-";
+        }
+        std::cout << std::setw(12) << ms << " ms";
+        if (baseline_ms > 0) {
+            std::cout << std::setw(10) << std::setprecision(2) << baseline_ms / ms << "x";
+        }
+        std::cout << std::endl;
+    }
+
+    std::vector<NPC_ptr> random_npcs(size_t count, int max_coord, unsigned seed) {
+        std::mt19937 rng(seed);
+        std::uniform_int_distribution<int> coord(0, max_coord - 1);
+        std::uniform_int_distribution<int> kind(DragonType, ToadType);
+        std::vector<NPC_ptr> npcs;
+        npcs.reserve(count);
+        for (size_t i = 0; i < count; ++i) {
+            npcs.push_back(factory(static_cast<NpcKind>(kind(rng)), "npc", coord(rng), coord(rng)));
+        }
+        return npcs;
+    }
+
+    // Прежняя реализация is_close на std::pow, для сравнения
+    bool legacy_is_close(const NPC &a, const NPC &b, size_t distance) {
+        return std::pow(a.x - b.x, 2) + std::pow(a.y - b.y, 2) <= std::pow(distance, 2);
+    }
+
+    void bench_is_close() {
+        auto npcs = random_npcs(3000, 1000, 1);
+        std::span<const NPC_ptr> all(npcs);
+
+        // Радиус берётся один раз на NPC во всех вариантах: сравнивается только сама проверка.
+        // Циклы короткие и зависят от соседних процессов, поэтому прогонов больше обычного
+        double legacy = measure_ms([&]() {
+            size_t found = 0;
+            for (size_t i = 0; i < all.size(); ++i) {
+                const NPC &self = *all[i];
+                size_t radius = self.kill_radius();
+                for (const NPC_ptr &other : all.subspan(i + 1)) {
+                    found += legacy_is_close(self, *other, radius);
+                }
+            }
+            return found;
+        }, 15);
+
+        double pairwise = measure_ms([&]() {
+            size_t found = 0;
+            for (size_t i = 0; i < all.size(); ++i) {
+                const NPC &self = *all[i];
+                size_t radius = self.kill_radius();
+                for (const NPC_ptr &other : all.subspan(i + 1)) {
+                    found += self.is_close(*other, radius);
+                }
+            }
+            return found;
+        }, 15);
+
+        double reached = measure_ms([&]() {
+            size_t found = 0;
+            for (size_t i = 0; i < all.size(); ++i) {
+                const NPC &self = *all[i];
+                Reach reach = self.kill_reach();
+                for (const NPC_ptr &other : all.subspan(i + 1)) {
+                    found += self.is_close(*other, reach);
+                }
+            }
+            return found;
+        }, 15);
+
+        std::vector<uint32_t> hits;
+        double batched = measure_ms([&]() {
+            size_t found = 0;
+            for (size_t i = 0; i < all.size(); ++i) {
+                hits.clear();
+                found += all[i]->is_close(all.subspan(i + 1), all[i]->kill_radius(), hits);
+            }
+            return found;
+        }, 15);
+
+        report("is_close pairwise (3000 NPC)", legacy, pairwise);
+        report("is_close kill_reach (3000 NPC)", legacy, reached);
+        report("is_close span (3000 NPC)", legacy, batched);
+    }
+
+    void bench_spatial() {
+        constexpr int COUNT = 20000;
+        World world;
+        for (auto &npc : random_npcs(COUNT, 2000, 2)) {
+            world.spawn(npc);
+        }
+        const KindRegistry &kinds = KindRegistry::instance();
+        auto all = world.view();
+        std::vector<uint32_t> hits;
+
+        // Поиск пар для сражений: полный перебор против сетки (с учётом её перестройки)
+        double scan = measure_ms([&]() {
+            size_t found = 0;
+            for (size_t i = 0; i < all.size(); ++i) {
+                int kind = world.kind_at(i);
+                if (!kinds.is_predator(kind)) {
+                    continue;
+                }
+                hits.clear();
+                all[i]->is_close(all.subspan(i + 1), kinds.kill_radius(kind), hits);
+                for (uint32_t h : hits) {
+                    found += kinds.can_kill(kind, world.kind_at(i + 1 + h));
+                }
+            }
+            return found;
+        }, 3);
+
+        SpatialIndex index;
+        double grid = measure_ms([&]() {
+            size_t found = 0;
+            index.rebuild(world);
+            for (size_t i = 0; i < all.size(); ++i) {
+                int kind = world.kind_at(i);
+                if (!kinds.is_predator(kind)) {
+                    continue;
+                }
+                hits.clear();
+                index.radius(all[i]->x, all[i]->y, kinds.kill_radius(kind), hits, kinds.prey_mask(kind));
+                for (uint32_t j : hits) {
+                    found += j > i;
+                }
+            }
+            return found;
+        }, 3);
+        report("fight pairs scan vs grid (20000 NPC)", scan, grid);
+
+        // Ближайшая жертва для каждого хищника: линейный просмотр против колец сетки
+        constexpr size_t QUERIES = 2000;
+        double linear = measure_ms([&]() {
+            size_t found = 0;
+            for (size_t i = 0; i < QUERIES; ++i) {
+                uint64_t prey = kinds.prey_mask(world.kind_at(i));
+                int64_t best = INT64_MAX;
+                for (size_t j = 0; j < all.size(); ++j) {
+                    if (j != i && (prey >> world.kind_at(j) & 1)) {
+                        best = std::min(best, squared(all[j]->x - all[i]->x) + squared(all[j]->y - all[i]->y));
+                    }
+                }
+                found += best != INT64_MAX;
+            }
+            return found;
+        }, 3);
+        double rings = measure_ms([&]() {
+            size_t found = 0;
+            for (size_t i = 0; i < QUERIES; ++i) {
+                hits.clear();
+                index.nearest_prey(world, i, 1, hits);
+                found += hits.size();
+            }
+            return found;
+        }, 3);
+        report("nearest prey x2000 linear vs grid", linear, rings);
+    }
+
+    // Поиск пар и перестройка сетки при перекосе видов (1% драконов, 9% быков, 90% жаб);
+    // сравнивать не с чем - замер сравнивается между сборками
+    void bench_broadphase() {
+        constexpr int COUNT = 100000;
+        constexpr int SIDE = 4472;
+        std::mt19937 rng(9);
+        std::uniform_int_distribution<int> coord(0, SIDE - 1);
+        std::uniform_int_distribution<int> percent(0, 99);
+        World world;
+        for (int i = 0; i < COUNT; ++i) {
+            int p = percent(rng);
+            NpcKind kind = p < 1 ? DragonType : p < 10 ? BullType : ToadType;
+            world.spawn(factory(kind, "npc", coord(rng), coord(rng)));
+        }
+        const KindRegistry &kinds = KindRegistry::instance();
+        SpatialIndex index;
+        std::vector<uint32_t> hits;
+        double detect_ms = measure_ms([&]() {
+            size_t found = 0;
+            index.rebuild(world);
+            for (size_t i = 0; i < world.size(); ++i) {
+                const PackedNpc &a = world.hot_at(i);
+                if (!kinds.is_predator(a.kind)) {
+                    continue;
+                }
+                hits.clear();
+                index.radius(a.x, a.y, kinds.kill_radius(a.kind), hits, kinds.prey_mask(a.kind));
+                for (uint32_t j : hits) {
+                    found += j > i;
+                }
+            }
+            return found;
+        }, 5);
+        report("fight pairs, skewed kinds (10^5)", 0, detect_ms);
+        double rebuild_ms = measure_ms([&]() {index.rebuild(world); return index.size();}, 5);
+        report("grid rebuild, skewed kinds (10^5)", 0, rebuild_ms);
+    }
+
+    // Перестройка полей направлений и выбор шага: "baseline" - однопоточная перестройка
+    void bench_flow() {
+        constexpr int SIDE = 4472;
+        World world;
+        for (auto &npc : random_npcs(100000, SIDE, 3)) {
+            world.spawn(npc);
+        }
+        FlowField flow;
+        double single = measure_ms([&]() {
+            flow.rebuild(world, SIDE, SIDE, 0, 1);
+            return flow.fields();
+        }, 3);
+        double parallel = measure_ms([&]() {
+            flow.rebuild(world, SIDE, SIDE, 0, 0);
+            return flow.fields();
+        }, 3);
+        report("flow rebuild 1 vs N threads (10^5 NPC)", single, parallel);
+
+        double steer = measure_ms([&]() {
+            size_t moving = 0;
+            for (size_t i = 0; i < world.size(); ++i) {
+                auto [dx, dy] = flow.direction(world.at(i)->x, world.at(i)->y, world.kind_at(i));
+                moving += dx != 0 || dy != 0;
+            }
+            return moving;
+        }, 3);
+        report("flow rebuild vs steering all NPCs", single, steer);
+    }
+
+    // Создание мира из 10^6 NPC: "baseline" - прежний цикл main (имя через to_string, factory
+    // с подпиской, ещё две подписки, spawn по одному), "current" - generate_world
+    void bench_generate() {
+        constexpr size_t COUNT = 1000000;
+        constexpr int SIDE = 10000;
+        double loop = measure_ms([&]() {
+            Simulation sim(SIDE, SIDE, 1);
+            std::mt19937 rng(1);
+            std::uniform_int_distribution<int> coord(0, SIDE - 1);
+            std::uniform_int_distribution<int> kind(DragonType, ToadType);
+            for (size_t i = 0; i < COUNT; ++i) {
+                NpcKind k = static_cast<NpcKind>(kind(rng));
+                auto npc = factory(k, KindRegistry::instance().info(k).name + "_" + std::to_string(i), coord(rng), coord(rng));
+                npc->subscribe(TextObserver::get());
+                npc->subscribe(FileObserver::get());
+                sim.spawn(npc);
+            }
+            return sim.world().size();
+        }, 3);
+        double bulk = measure_ms([&]() {
+            Simulation sim(SIDE, SIDE, 1);
+            WorldSpec spec;
+            spec.count = COUNT;
+            spec.seed = 1;
+            return generate_world(sim, spec);
+        }, 3);
+        report("world of 10^6 NPC: loop vs generate", loop, bulk);
+    }
+
+    // Броски для 10^6 пар: "baseline" - два d6 на общем mt19937, "current" - счётчиковые кости пачкой
+    void bench_dice() {
+        constexpr size_t EVENTS = 1000000;
+        std::vector<uint8_t> attack(EVENTS), defense(EVENTS);
+        double shared = measure_ms([&]() {
+            std::mt19937 rng(1);
+            std::uniform_int_distribution<int> d6(1, 6);
+            size_t wins = 0;
+            for (size_t i = 0; i < EVENTS; ++i) {
+                int a = d6(rng);
+                int d = d6(rng);
+                wins += a > d;
+            }
+            return wins;
+        });
+        CounterDice dice(1);
+        double counter = measure_ms([&]() {
+            dice.roll(1, 0, attack, defense);
+            size_t wins = 0;
+            for (size_t i = 0; i < EVENTS; ++i) {
+                wins += attack[i] > defense[i];
+            }
+            return wins;
+        });
+        report("d6 pairs x10^6: mt19937 vs counter", shared, counter);
+    }
+
+    // Поиск пар как в Simulation::move_tick на 10^5 NPC: "baseline" - плотный массив в порядке
+    // появления (с положением не связан), "current" - после сортировки по кривой Z-порядка
+    void bench_locality() {
+        constexpr int SIDE = 3000;
+        World world;
+        for (auto &npc : random_npcs(100000, SIDE, 4)) {
+            world.spawn(npc);
+        }
+        const KindRegistry &kinds = KindRegistry::instance();
+        SpatialIndex index;
+        std::vector<uint32_t> hits;
+        std::vector<FightEvent> events;
+        auto detect = [&]() {
+            auto lock = world.read_lock();
+            events.clear();
+            index.rebuild(world);
+            for (size_t i = 0; i < world.size(); ++i) {
+                const PackedNpc &a = world.hot_at(i);
+                if (!kinds.is_predator(a.kind) || !world.alive_at(i)) {
+                    continue;
+                }
+                hits.clear();
+                index.radius(a.x, a.y, kinds.kill_radius(a.kind), hits, kinds.prey_mask(a.kind));
+                std::sort(hits.begin(), hits.end());
+                for (uint32_t j : hits) {
+                    if (j > i && world.alive_at(j)) {
+                        events.push_back(FightEvent{world.id_at(i), world.id_at(j)});
+                    }
+                }
+            }
+            return events.size();
+        };
+        double before = measure_ms(detect, 5);
+        double disorder_before, disorder_after;
+        std::vector<uint32_t> order;
+        {
+            auto lock = world.read_lock();
+            disorder_before = morton_disorder(world);
+            morton_order(world, order);
+        }
+        double sort_ms = measure_ms([&]() {
+            world.reorder(order);
+            return order.size();
+        }, 1);
+        {
+            auto lock = world.read_lock();
+            disorder_after = morton_disorder(world);
+        }
+        double after = measure_ms(detect, 5);
+        report("fight pairs unsorted vs Z-order (10^5)", before, after);
+        std::cout << "  disorder " << disorder_before << " -> " << disorder_after
+                  << ", reorder " << sort_ms << " ms" << std::endl;
+    }
+
+    // Строки об убийствах в поток без вывода: "baseline" - прежний operator<< с get_name() и std::endl,
+    // "current" - запись в приёмник, текст в буфере потока, одна запись в поток
+    void bench_log() {
+        constexpr size_t LINES = 100000;
+        struct NullBuffer : std::streambuf {
+            int overflow(int c) override {return c;}
+            std::streamsize xsputn(const char *, std::streamsize n) override {return n;}
+        } null_buffer;
+        std::ostream null_stream(&null_buffer);
+        auto npcs = random_npcs(2, 100, 5);
+        npcs[1]->name.clear();
+
+        double streamed = measure_ms([&]() {
+            for (size_t i = 0; i < LINES; ++i) {
+                null_stream << npcs[0]->get_name() << " killed " << npcs[1]->get_name()
+                            << " (Attack: " << int(i % 6 + 1) << " vs Defense: " << int(i % 5 + 1) << ")" << std::endl;
+            }
+            return LINES;
+        });
+        StreamSink sink(null_stream, LogFormat::Detailed);
+        auto submit_all = [&]() {
+            for (size_t i = 0; i < LINES; ++i) {
+                sink.submit(LogRecord{LogRecord::Kill, npcs[0].get(), npcs[1].get(), i,
+                                      static_cast<uint8_t>(i % 6 + 1), static_cast<uint8_t>(i % 5 + 1)});
+            }
+            return LINES;
+        };
+        double buffered = measure_ms(submit_all);
+        report("kill lines x10^5: iostream vs sink", streamed, buffered);
+        sink.set_enabled(false);
+        double disabled = measure_ms(submit_all);
+        report("kill lines x10^5: iostream vs disabled", streamed, disabled);
+    }
+
+    // Основной цикл: Simulation::tick() на мире из 2*10^4 NPC с фиксированным seed, случайное
+    // блуждание и поля направлений. Прогон детерминирован - им же обучается PGO (bench/pgo.sh)
+    void bench_simulation() {
+        constexpr size_t COUNT = 20000;
+        constexpr int SIDE = 1400;
+        constexpr int TICKS = 200;
+        for (bool flow : {false, true}) {
+            size_t kills = 0;
+            size_t moves = 0;
+            double ms = measure_ms([&]() {
+                Simulation sim(SIDE, SIDE, 7);
+                sim.print_kills = false;
+                sim.set_flow(flow);
+                WorldSpec spec;
+                spec.count = COUNT;
+                spec.seed = 7;
+                generate_world(sim, spec);
+                kills = 0;
+                moves = 0;
+                for (int t = 0; t < TICKS; ++t) {
+                    kills += sim.tick();
+                    moves += sim.resumed();
+                }
+                return kills;
+            }, 3);
+            report(flow ? "main loop 2x10^4 NPC x200, flow" : "main loop 2x10^4 NPC x200, walk", 0, ms);
+            std::cout << "  " << kills << " kills, " << moves / TICKS << " coroutines resumed per tick" << std::endl;
+        }
+    }
+
+    struct Benchmark {
+        const char *name;
+        void (*run)();
+    };
+
+    const Benchmark benchmarks[] = {
+        {"is_close", bench_is_close},
+        {"spatial", bench_spatial},
+        {"broadphase", bench_broadphase},
+        {"flow", bench_flow},
+        {"generate", bench_generate},
+        {"dice", bench_dice},
+        {"locality", bench_locality},
+        {"log", bench_log},
+        {"simulation", bench_simulation},
+    };
+}
+
+int main(int argc, char **argv) {
+    const char *filter = argc > 1 ? argv[1] : nullptr;
+    std::cout << std::left << std::setw(40) << "benchmark"
+              << std::right << std::setw(15) << "baseline"
+              << std::setw(15) << "current"
+              << std::setw(11) << "speedup" << std::endl;
+    for (auto &b : benchmarks) {
+        if (!filter || std::strstr(b.name, filter)) {
+            b.run();
+        }
+    }
+    return 0;
+}
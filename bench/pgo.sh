@@ -0,0 +1,54 @@
+#!/usr/bin/env bash
+# Сборки основного цикла и их сравнение на ./benchmarks simulation:
+#   Release             -O3
+#   Release-Perf        -O3, LTO, -march=native
+#   Release-Perf + PGO  то же, по профилю: инструментированная сборка -> обучающий прогон -> пересборка
+# ./bench/pgo.sh [КАТАЛОГ] [аргументы cmake ...]   (по умолчанию _perf в корне проекта)
+set -euo pipefail
+SRC=$(cd "$(dirname "$0")/.." && pwd)
+OUT=${1:-$SRC/_perf}
+shift || true
+EXTRA=("$@")
+JOBS=$(nproc)
+
+build() {
+    local dir=$1
+    shift
+    if ! { cmake -S "$SRC" -B "$dir" "${EXTRA[@]}" "$@" && cmake --build "$dir" -j"$JOBS" --target benchmarks; } > "$dir.log" 2>&1; then
+        echo "Build failed, see $dir.log" >&2
+        exit 1
+    fi
+}
+
+# Время walk и flow из строк "main loop" - последнее число перед "ms"
+times() {
+    "$1/benchmarks" simulation | awk '/main loop/ {for (i = NF; i > 0; --i) if ($i == "ms") {printf "%s ", $(i - 1); break}}'
+}
+
+mkdir -p "$OUT"
+echo "Release..."
+build "$OUT/release" -DCMAKE_BUILD_TYPE=Release
+echo "Release-Perf..."
+build "$OUT/perf" -DCMAKE_BUILD_TYPE=Release-Perf -DNPC_PGO=
+# Профиль привязан к путям объектных файлов, поэтому обе стадии PGO собираются в одном каталоге
+echo "Release-Perf + PGO: instrumented build and training run..."
+rm -rf "$OUT/pgo/pgo"
+build "$OUT/pgo" -DCMAKE_BUILD_TYPE=Release-Perf -DNPC_PGO=generate
+"$OUT/pgo/benchmarks" simulation > /dev/null
+echo "Release-Perf + PGO: optimised build..."
+build "$OUT/pgo" -DCMAKE_BUILD_TYPE=Release-Perf -DNPC_PGO=use
+
+release=$(times "$OUT/release")
+perf=$(times "$OUT/perf")
+pgo=$(times "$OUT/pgo")
+echo
+awk -v r="$release" -v p="$perf" -v g="$pgo" 'BEGIN {
+    split(r, base, " ")
+    printf "%-22s %12s %12s %10s %10s\n", "build", "walk ms", "flow ms", "walk", "flow"
+    n = split("Release|Release-Perf|Release-Perf + PGO", names, "|")
+    runs[1] = r; runs[2] = p; runs[3] = g
+    for (i = 1; i <= n; ++i) {
+        split(runs[i], t, " ")
+        printf "%-22s %12.1f %12.1f %9.2fx %9.2fx\n", names[i], t[1], t[2], base[1] / t[1], base[2] / t[2]
+    }
+}'
@@ -0,0 +1,46 @@
+#pragma once
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "kind_registry.h"
+
+// Пакетный прогон для подбора параметров видов: много независимых миров без вывода и пауз,
+// параллельно по ядрам. Конфигурация - таблица видов с изменёнными шагом / радиусом.
+struct BatchConfig {
+    std::string label;
+    KindRegistry kinds;
+};
+
+struct BatchOptions {
+    size_t worlds{10};
+    size_t npcs{50};
+    int width{100};
+    int height{100};
+    uint64_t ticks{3000};
+    uint32_t seed{1};
+    unsigned threads{0};
+    bool flow{false};
+};
+
+// Итог одного мира. Прогон заканчивается раньше ticks, если ни одному виду больше некого убить
+struct BatchRun {
+    size_t config{0};
+    uint32_t seed{0};
+    uint64_t ticks{0};
+    std::vector<uint32_t> survivors;
+    double seconds{0};
+};
+
+// Декартово произведение вариаций вида "Dragon.step=20,30,40" или "Bull.radius=5,10" над base.
+// Без вариаций - одна конфигурация base. false и сообщение в std::cerr при ошибке разбора
+bool expand_configs(const KindRegistry &base, const std::vector<std::string> &vary, std::vector<BatchConfig> &configs);
+
+// worlds миров на каждую конфигурацию; мир i получает seed + i во всех конфигурациях,
+// так что конфигурации сравниваются на одинаковых стартовых расстановках
+std::vector<BatchRun> run_batch(const std::vector<BatchConfig> &configs, const BatchOptions &options);
+
+// Строка на мир: config,label,seed,ticks,<выжившие по видам>
+void write_csv(std::ostream &os, const std::vector<BatchConfig> &configs, const std::vector<BatchRun> &runs);
+// Строка на конфигурацию: среднее и стандартное отклонение выживших по видам
+void write_summary(std::ostream &os, const std::vector<BatchConfig> &configs, const std::vector<BatchRun> &runs);
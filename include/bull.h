@@ -2,15 +2,19 @@
 #include "npc.h"
 
 struct Bull : public NPC {
-    Bull() = default;
+    static constexpr int STEP = 30;
+    static constexpr int KILL_RADIUS = 10;
+
+    Bull();
     Bull(const std::string &name_, int x_, int y_);
     Bull(std::istream &is);
     bool accept(const NPC_ptr &attacker) override;
     bool visit_dragon(const std::shared_ptr<Dragon> &defender) override;
     bool visit_bull(const std::shared_ptr<Bull> &defender) override;
     bool visit_toad(const std::shared_ptr<Toad> &defender) override;
-    void print() const override;
+    bool visit_creature(const std::shared_ptr<Creature> &defender) override;
+    void describe(TextBuffer &out) const override;
     void save(std::ostream &os) const override;
-    int step() const override{return 30;}
-    int kill_radius() const override{return 10;}
+    int step() const override;
+    int kill_radius() const override;
 };
\ No newline at end of file
@@ -0,0 +1,93 @@
+#pragma once
+#include <condition_variable>
+#include <cstdint>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <utility>
+#include <vector>
+#include "kind_registry.h"
+
+// Пара, переданная потоку сражений до снимка и ещё не разобранная: индексы записей снимка и броски
+struct SnapshotFight {
+    uint32_t attacker;
+    uint32_t defender;
+    uint8_t attack;
+    uint8_t defense;
+    uint16_t reserved{0};
+};
+
+// Снимок мира между тиками: плоские массивы в плотном порядке World
+// плюс состояние генераторов, чтобы продолжить ровно с того же тика.
+struct WorldSnapshot {
+    uint64_t tick{0};
+    int32_t max_x{0};
+    int32_t max_y{0};
+    std::string move_rng;
+    uint64_t dice_seed{0};
+
+    std::vector<uint8_t> kinds;
+    std::vector<uint8_t> alive;
+    std::vector<int32_t> xs;
+    std::vector<int32_t> ys;
+    std::vector<uint32_t> serials;
+    // Явные имена по записям ("" - имя строится из вида и serial). capture() строк не копирует:
+    // для NPC с явным именем запоминается указатель (имя после создания не меняется), а сами строки
+    // читает писатель. После read_snapshot заполнен names, named пуст
+    std::vector<std::string> names;
+    std::vector<std::pair<uint32_t, NPC_ptr>> named;
+    // Индексы записей в порядке, в котором планировщик возобновит их корутины,
+    // и через сколько тиков после снимка каждая проснётся (спящие NPC - не на следующем)
+    std::vector<uint32_t> wake_order;
+    std::vector<uint32_t> wake_delay;
+    std::vector<SnapshotFight> fights;
+    // Таблица видов, с которой сделан снимок
+    std::vector<KindInfo> kind_table;
+    std::vector<uint64_t> kind_prey;
+
+    size_t size() const {return kinds.size();}
+    std::string_view name(size_t i) const;
+    void clear();
+};
+
+// Бинарный формат: "NPCCKPT4", затем поля в порядке объявления, числа в порядке байт машины
+void write_snapshot(std::ostream &os, const WorldSnapshot &snapshot);
+bool read_snapshot(std::istream &is, WorldSnapshot &snapshot);
+
+// Пишет снимки в файл на фоновом потоке. Тик только обменивается буферами с писателем;
+// если предыдущий снимок ещё пишется, новый пропускается.
+class Checkpointer {
+public:
+    struct Stats {
+        size_t written{0};
+        size_t skipped{0};
+        size_t bytes{0};
+        double capture_ms_total{0};
+        double capture_ms_max{0};
+        double write_ms_total{0};
+        double write_ms_max{0};
+    };
+
+    explicit Checkpointer(std::string path_);
+    ~Checkpointer();
+    Checkpointer(const Checkpointer &) = delete;
+    Checkpointer &operator=(const Checkpointer &) = delete;
+
+    bool submit(WorldSnapshot &snapshot, double capture_ms);
+    void flush();
+    Stats stats() const;
+
+private:
+    void run();
+
+    std::string path;
+    WorldSnapshot buffer;
+    bool pending{false};
+    bool stopping{false};
+    Stats counters;
+    mutable std::mutex mtx;
+    std::condition_variable cv;
+    std::thread worker;
+};
@@ -0,0 +1,16 @@
+#pragma once
+#include "npc.h"
+
+// NPC вида, описанного только в таблице KindRegistry: параметры и правила боя берутся из неё
+struct Creature : public NPC {
+    Creature(int kind_, const std::string &name_, int x_, int y_);
+    bool accept(const NPC_ptr &attacker) override;
+    bool visit_dragon(const std::shared_ptr<Dragon> &defender) override;
+    bool visit_bull(const std::shared_ptr<Bull> &defender) override;
+    bool visit_toad(const std::shared_ptr<Toad> &defender) override;
+    bool visit_creature(const std::shared_ptr<Creature> &defender) override;
+    void describe(TextBuffer &out) const override;
+    void save(std::ostream &os) const override;
+    int step() const override;
+    int kill_radius() const override;
+};
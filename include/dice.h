@@ -0,0 +1,24 @@
+#pragma once
+#include <cstdint>
+#include <span>
+#include <utility>
+
+// Счётчиковый генератор бросков d6: пара (атака, защита) зависит только от (seed, тик, номер события),
+// а не от того, сколько бросков было до неё, - общий поток генератора не нужен, и любой бой
+// можно перебросить отдельно. Номер события хешируется 32-битной функцией (финализатор murmur3)
+// с ключом тика; цикл по событиям без ветвлений и на 32-битных числах, компилятор его векторизует.
+// Кость берётся из 16 бит хеша: смещение вероятностей граней не больше 6 / 65536.
+class CounterDice {
+public:
+    explicit CounterDice(uint64_t seed_ = 0) : seed(seed_) {}
+
+    uint64_t seed_value() const {return seed;}
+    // Броски для событий first, first + 1, ... тика tick; attack и defense одной длины
+    void roll(uint64_t tick, uint32_t first, std::span<uint8_t> attack, std::span<uint8_t> defense) const;
+    std::pair<int, int> roll(uint64_t tick, uint32_t index) const;
+
+private:
+    uint32_t tick_key(uint64_t tick) const;
+
+    uint64_t seed;
+};
@@ -0,0 +1,160 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "npc.h"
+#include "kind_registry.h"
+#include "text_buffer.h"
+
+// Событие боя как данные: тип, участники и броски. Производитель (поток сражений, наблюдатели,
+// BattleManager) только заполняет запись и отдаёт её приёмнику; текст строится в буфере потока,
+// когда приёмник запись принял. Выключенный или отфильтровавший запись приёмник не форматирует ничего.
+// Указатели в записи действительны только на время submit() - запись рендерится сразу.
+
+enum class LogLevel : uint8_t {Debug, Info, Warning, Off};
+
+// Итог разбора сражений за тик: вместо строки на каждое убийство
+struct KillTally {
+    uint32_t kills{0};
+    // Убитые по id вида
+    std::vector<uint32_t> by_kind;
+    const KindRegistry *kinds{nullptr};
+
+    void reset(const KindRegistry &registry) {
+        kills = 0;
+        by_kind.assign(registry.size(), 0);
+        kinds = &registry;
+    }
+};
+
+struct LogRecord {
+    enum Type : uint8_t {
+        Kill,       // "<a> killed <b>", с бросками, если attack != 0
+        Murder,     // убийство, о котором сообщил наблюдатель
+        Battle,     // пара в радиусе атаки у BattleManager
+        Summary,    // итог тика, tally
+        TYPE_COUNT
+    };
+
+    Type type{Kill};
+    const NPC *first{nullptr};
+    const NPC *second{nullptr};
+    uint64_t tick{0};
+    uint8_t attack{0};
+    uint8_t defense{0};
+    LogLevel level{LogLevel::Info};
+    const KillTally *tally{nullptr};
+
+    static constexpr uint32_t bit(Type type) {return uint32_t{1} << type;}
+    static constexpr uint32_t ALL = (uint32_t{1} << TYPE_COUNT) - 1;
+};
+
+// Detailed - как print() участников (консоль), Compact - одна строка на участников (файл журнала)
+enum class LogFormat {Detailed, Compact};
+
+void render(const LogRecord &record, LogFormat format, TextBuffer &out);
+
+// "debug", "info", "warning", "off"; false - неизвестное имя
+bool parse_log_level(std::string_view name, LogLevel &level);
+
+// Приёмник записей. Фильтры проверяются по порядку и все - до форматирования:
+// включён ли приёмник, уровень и тип записи, выборка 1 из N (кроме итогов тика, Summary),
+// ограничение числа записей в секунду. О записях, отброшенных ограничением, приёмник
+// сообщает одной строкой перед следующей пропущенной записью.
+class LogSink {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    struct Stats {
+        uint64_t written{0};
+        uint64_t filtered{0};
+        uint64_t sampled_out{0};
+        uint64_t rate_limited{0};
+    };
+
+    explicit LogSink(LogFormat format_) : format(format_) {}
+    virtual ~LogSink() = default;
+    LogSink(const LogSink &) = delete;
+    LogSink &operator=(const LogSink &) = delete;
+
+    bool accepts(const LogRecord &record) const {
+        return enabled.load(std::memory_order_relaxed) && record.level >= min_level.load(std::memory_order_relaxed)
+            && (types.load(std::memory_order_relaxed) >> record.type & 1);
+    }
+    void submit(const LogRecord &record);
+
+    void set_enabled(bool on) {enabled.store(on, std::memory_order_relaxed);}
+    void set_level(LogLevel level) {min_level.store(level, std::memory_order_relaxed);}
+    void set_types(uint32_t mask) {types.store(mask, std::memory_order_relaxed);}
+    // Каждая запись проходит с вероятностью 1/one_in (1 - все); seed задаёт последовательность выборки
+    void set_sampling(uint32_t one_in, uint64_t seed = 0);
+    // Не больше per_second записей в секунду, 0 - без ограничения
+    void set_rate_limit(uint32_t per_second) {rate_limit.store(per_second, std::memory_order_relaxed);}
+
+    Stats stats() const;
+
+protected:
+    // Готовый текст записи; может вызываться из нескольких потоков сразу
+    virtual void write_text(std::string_view text) = 0;
+
+private:
+    bool sampled(const LogRecord &record);
+    // dropped - сколько записей отброшено ограничением с прошлой пропущенной
+    bool within_rate(uint64_t &dropped);
+
+    LogFormat format;
+    std::atomic<bool> enabled{true};
+    std::atomic<LogLevel> min_level{LogLevel::Debug};
+    std::atomic<uint32_t> types{LogRecord::ALL};
+    std::atomic<uint32_t> sample_one_in{1};
+    std::atomic<uint64_t> sample_seed{0};
+    std::atomic<uint64_t> sample_counter{0};
+    std::atomic<uint32_t> rate_limit{0};
+    std::mutex rate_mtx;
+    Clock::time_point window_start{};
+    uint32_t window_count{0};
+    uint64_t unreported{0};
+
+    std::atomic<uint64_t> written{0};
+    std::atomic<uint64_t> filtered{0};
+    std::atomic<uint64_t> sampled_out{0};
+    std::atomic<uint64_t> rate_limited{0};
+};
+
+// Запись в поток вывода под своим мьютексом, каждая запись - одним write
+class StreamSink : public LogSink {
+public:
+    StreamSink(std::ostream &os_, LogFormat format_, bool flush_ = true) : LogSink(format_), os(os_), flush(flush_) {}
+
+protected:
+    void write_text(std::string_view text) override;
+
+private:
+    std::ostream &os;
+    bool flush;
+    std::mutex mtx;
+};
+
+// Дозапись в файл
+class FileSink : public LogSink {
+public:
+    FileSink(const std::string &path, LogFormat format_);
+    bool is_open() const {return file.is_open();}
+
+protected:
+    void write_text(std::string_view text) override;
+
+private:
+    std::ofstream file;
+    std::mutex mtx;
+};
+
+// Общий приёмник std::cout в подробном формате: через него печатают поток сражений и TextObserver
+LogSink &console_log();
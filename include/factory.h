@@ -1,6 +1,10 @@
 #pragma once
 #include "npc.h"
+#include "npc_arena.h"
 
-enum NpcKind { DragonType = 1, BullType = 2, ToadType = 3 };
+// Только объект нужного вида, без наблюдателей; nullptr - вид неизвестен
+std::shared_ptr<NPC> create(NpcKind type, const std::string &name, int x, int y);
+// То же, объект со счётчиками ссылок - в арене
+std::shared_ptr<NPC> create(NpcArena &arena, NpcKind type, const std::string &name, int x, int y);
 std::shared_ptr<NPC> factory(NpcKind type, const std::string &name, int x, int y);
 std::shared_ptr<NPC> factory(std::istream &is);
\ No newline at end of file
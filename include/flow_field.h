@@ -0,0 +1,72 @@
+#pragma once
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+#include "world.h"
+#include "kind_registry.h"
+
+// Поля направлений для движения "к добыче / от угрозы". Мир делится на клетки, по клеткам
+// с живыми NPC нужных видов считается BFS от многих источников (4 соседа): для хищника -
+// от клеток с его жертвами, для жертвы - от клеток с теми, кто может её убить.
+// Поля с одинаковым набором видов-источников считаются один раз, разные - параллельно.
+// После перестройки направление для любого NPC выбирается за O(1) по соседним клеткам.
+// Потоки перестройки создаются при первой перестройке с threads > 1 и ждут следующей до разрушения поля.
+class FlowField {
+public:
+    static constexpr uint16_t UNREACHED = 0xFFFF;
+
+    explicit FlowField(const KindRegistry &registry_ = KindRegistry::instance()) : registry(registry_) {}
+    ~FlowField();
+    FlowField(const FlowField &) = delete;
+    FlowField &operator=(const FlowField &) = delete;
+
+    // Вызывающий держит read_lock() мира. cell_size 0 - половина наименьшего радиуса убийства,
+    // threads 0 - по числу ядер, 1 - всё на вызывающем потоке
+    void rebuild(const World &world, int width, int height, int cell_size = 0, unsigned threads = 0);
+
+    // Шаг по клеткам (-1..1, -1..1): от угрозы, если она ближе дальности её броска, иначе к ближайшей жертве.
+    // {0, 0} - полей для вида нет или жертва в той же клетке
+    std::pair<int, int> direction(int x, int y, int kind) const;
+
+    // Расстояния в клетках до ближайшей жертвы / угрозы для вида kind, UNREACHED - нет таких
+    uint16_t prey_distance(int x, int y, int kind) const;
+    uint16_t threat_distance(int x, int y, int kind) const;
+
+    int cell_size() const {return cell;}
+    size_t fields() const {return distances.size();}
+
+private:
+    size_t cell_index(int x, int y) const;
+    void fill(size_t field, const std::vector<uint64_t> &occupied);
+    std::pair<int, int> best_neighbour(size_t field, size_t from, bool toward) const;
+    // job(t) для t = 0..workers-1: t = 0 - на вызывающем потоке, остальные - на потоках pool
+    void run_parallel(unsigned workers, const std::function<void(unsigned)> &task);
+    void worker_loop(unsigned t, uint64_t seen);
+
+    const KindRegistry &registry;
+    int cell{1};
+    int cols{0};
+    int rows{0};
+    // Для каждого поля - маска видов-источников и расстояния по клеткам
+    std::vector<uint64_t> masks;
+    std::vector<std::vector<uint16_t>> distances;
+    // По виду: номер поля добычи и поля угрозы (-1 - нет) и порог бегства в клетках
+    std::vector<int> chase_field;
+    std::vector<int> flee_field;
+    std::vector<uint16_t> flee_cells;
+
+    // Постоянные потоки перестройки и текущее задание: номер раунда растёт с каждым заданием
+    std::vector<std::thread> pool;
+    std::mutex pool_mtx;
+    std::condition_variable pool_cv;
+    std::condition_variable done_cv;
+    const std::function<void(unsigned)> *job{nullptr};
+    unsigned job_workers{0};
+    unsigned job_pending{0};
+    uint64_t job_round{0};
+    bool stopping{false};
+};
@@ -0,0 +1,141 @@
+#pragma once
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Кольцо кадров мира в разделяемой памяти POSIX (shm_open). Симуляция пишет кадр один раз за тик,
+// читатели (другие процессы на той же машине) берут кадры прямо из сегмента, без копий на стороне
+// писателя и без обратной связи: медленный читатель не тормозит симуляцию, а теряет старые кадры.
+//
+// Раскладка сегмента (числа в порядке байт машины, смещения в байтах):
+//   0                      FrameRingHeader
+//   header.slots_offset    slot_count слотов по header.slot_bytes:
+//                            FrameSlotHeader, затем capacity записей FrameRecord
+// Кадр n (с нуля) лежит в слоте n % slot_count. Слот защищён счётчиком-seqlock sequence:
+// пока пишется кадр n, sequence = 2n + 1, после записи - 2n + 2. Читатель берёт sequence,
+// копирует кадр и перечитывает sequence: если значение изменилось, кадр перезаписан во время чтения.
+// Поля кадра писатель пишет release-записями, а читатель берёт acquire-чтениями (store_record, load_record):
+// прочитав хоть одно новое поле, читатель увидит и нечётный sequence. Отдельных барьеров нет - их не
+// моделирует ThreadSanitizer. На x86 такие чтения и записи - обычные mov.
+// header.published - число записанных кадров; новый кадр n есть, когда published > n.
+//
+// Этот заголовок и src/frame_ring.cpp (библиотека frame_ring) не зависят от остальной игры -
+// сторонний инструмент собирается только с ними.
+
+inline constexpr char FRAME_RING_MAGIC[8] = {'N', 'P', 'C', 'R', 'I', 'N', 'G', '1'};
+// Те же 8 байт одним словом: заголовок хранит магию атомарно, писатель ставит её последней
+inline constexpr uint64_t FRAME_RING_MAGIC_WORD = std::bit_cast<uint64_t>(FRAME_RING_MAGIC);
+inline constexpr size_t FRAME_RING_KINDS = 64;
+
+// NPC в кадре: id - индекс слота EntityId, постоянный, пока NPC жив; kind - id вида из таблицы заголовка
+struct FrameRecord {
+    int32_t x;
+    int32_t y;
+    uint32_t id;
+    uint8_t kind;
+    uint8_t alive;
+    uint16_t reserved;
+};
+static_assert(sizeof(FrameRecord) == 16);
+
+struct FrameKind {
+    char name[15];
+    char glyph;
+};
+
+struct FrameRingHeader {
+    std::atomic<uint64_t> magic;
+    uint32_t slot_count;
+    uint32_t capacity;
+    uint32_t record_bytes;
+    uint32_t kind_count;
+    uint64_t slots_offset;
+    uint64_t slot_bytes;
+    int32_t width;
+    int32_t height;
+    uint64_t writer_pid;
+    std::atomic<uint64_t> published;
+    // Виды с id 1..kind_count-1, имя с завершающим нулём (обрезается до 14 символов)
+    FrameKind kinds[FRAME_RING_KINDS];
+};
+
+struct FrameSlotHeader {
+    std::atomic<uint64_t> sequence;
+    uint64_t tick;
+    uint32_t count;
+    // Записей не хватило - в кадре только первые capacity NPC мира
+    uint32_t truncated;
+};
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free, "frame ring counters are shared between processes");
+
+// Запись и чтение полей кадра внутри seqlock слота: release / acquire по полю
+void store_record(FrameRecord &to, const FrameRecord &from);
+FrameRecord load_record(const FrameRecord &from);
+template <typename T>
+void store_field(T &to, T value) {std::atomic_ref<T>(to).store(value, std::memory_order_release);}
+template <typename T>
+T load_field(const T &from) {return std::atomic_ref<T>(const_cast<T &>(from)).load(std::memory_order_acquire);}
+
+// Кадр, скопированный читателем из кольца
+struct Frame {
+    uint64_t number{0};
+    uint64_t tick{0};
+    bool truncated{false};
+    std::vector<FrameRecord> records;
+};
+
+// Отображение сегмента; общее у писателя и читателя
+class FrameSegment {
+public:
+    FrameSegment() = default;
+    ~FrameSegment();
+    FrameSegment(const FrameSegment &) = delete;
+    FrameSegment &operator=(const FrameSegment &) = delete;
+
+    bool mapped() const {return base != nullptr;}
+    const std::string &name() const {return segment_name;}
+    FrameRingHeader &header() const {return *static_cast<FrameRingHeader *>(base);}
+    FrameSlotHeader &slot(uint64_t frame) const;
+    FrameRecord *records(FrameSlotHeader &slot) const {
+        return reinterpret_cast<FrameRecord *>(reinterpret_cast<char *>(&slot) + sizeof(FrameSlotHeader));
+    }
+
+protected:
+    bool create(const std::string &name, size_t bytes);
+    bool attach(const std::string &name);
+    void unmap();
+
+    void *base{nullptr};
+    size_t bytes{0};
+    std::string segment_name;
+    bool owner{false};
+};
+
+// Читатель кольца. Опрашивается в своём темпе: next() отдаёт кадры по порядку, latest() - последний.
+class FrameReader : public FrameSegment {
+public:
+    // name - имя сегмента shm_open ("/npc_world"); false и сообщение в std::cerr, если сегмента
+    // нет или раскладка другая
+    bool open(const std::string &name);
+
+    // Следующий непрочитанный кадр (после open() - самый старый в кольце); false - новых кадров нет.
+    // Если писатель обогнал читателя больше чем на кольцо, пропущенные кадры учитываются в lost()
+    // и чтение продолжается с самого старого
+    bool next(Frame &frame);
+    // Последний записанный кадр, непрочитанные до него пропускаются (в lost() не идут);
+    // false - после последнего прочитанного кадра новых нет
+    bool latest(Frame &frame);
+
+    uint64_t lost() const {return lost_frames;}
+    uint64_t published() const {return mapped() ? header().published.load(std::memory_order_acquire) : 0;}
+
+private:
+    bool copy(uint64_t number, Frame &frame);
+
+    uint64_t cursor{0};
+    uint64_t lost_frames{0};
+};
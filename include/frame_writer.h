@@ -0,0 +1,24 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include "frame_ring.h"
+#include "world.h"
+#include "kind_registry.h"
+
+// Писатель кольца кадров (раскладка - в frame_ring.h). Сегмент создаётся в open() и удаляется
+// вместе с писателем. Кадр пишется одним проходом по горячему массиву мира, сколько бы ни было читателей.
+class FrameWriter : public FrameSegment {
+public:
+    // capacity - наибольшее число NPC в кадре, slots - длина кольца в кадрах.
+    // false и сообщение в std::cerr, если сегмент не создать
+    bool open(const std::string &name, uint32_t capacity, int width, int height,
+              const KindRegistry &registry = KindRegistry::instance(), uint32_t slots = 8);
+
+    // Кадр с положениями на конец тика tick. Вызывает поток перемещения между своими тиками
+    void publish(const World &world, uint64_t tick);
+
+    uint64_t published() const {return frames;}
+
+private:
+    uint64_t frames{0};
+};
@@ -0,0 +1,66 @@
+#pragma once
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "npc.h"
+
+struct KindInfo {
+    std::string name;
+    char glyph{'?'};
+    int step{0};
+    int kill_radius{0};
+};
+
+// Таблица видов NPC: параметры и матрица "кто кого может убить" в плотных массивах по id вида.
+// id 1-3 - встроенные Dragon, Bull, Toad (совпадают с NpcKind), id 0 не используется.
+// Формат файла - строка на вид: "имя символ шаг радиус [жертва ...]", '#' - комментарий.
+class KindRegistry {
+public:
+    static constexpr int MAX_KINDS = MAX_NPC_KINDS;
+
+    KindRegistry();
+    static KindRegistry &instance();
+
+    int add(const KindInfo &info);
+    bool load(std::istream &is);
+    bool load_file(const std::string &path);
+    // Вся таблица по id вида (вместе с неиспользуемым id 0) и строки матрицы масками - для снимков.
+    // load_table заменяет таблицу целиком и при ошибке оставляет её прежней
+    void save_table(std::vector<KindInfo> &table, std::vector<uint64_t> &prey) const;
+    bool load_table(const std::vector<KindInfo> &table, const std::vector<uint64_t> &prey);
+    bool same_table(const std::vector<KindInfo> &table, const std::vector<uint64_t> &prey) const;
+
+    size_t size() const {return infos.size();}
+    bool known(int kind) const {return kind > 0 && kind < static_cast<int>(infos.size());}
+    const KindInfo &info(int kind) const {return infos[kind];}
+    int find(std::string_view name) const;
+
+    int step(int kind) const {return steps[kind];}
+    int kill_radius(int kind) const {return radii[kind];}
+    // Радиус убийства с квадратом, пересчитываются в set_params
+    Reach kill_reach(int kind) const {return reaches[kind];}
+    int64_t kill_radius_sq(int kind) const {return reaches[kind].radius_sq;}
+    char glyph(int kind) const {return glyphs[kind];}
+    bool is_predator(int kind) const {return predators[kind];}
+    bool can_kill(int attacker, int defender) const {return kills[attacker * MAX_KINDS + defender];}
+    // Строка матрицы битовой маской: бит d установлен, если attacker может убить вид d
+    uint64_t prey_mask(int attacker) const {return prey_masks[attacker];}
+
+    void set_params(int kind, int step_, int kill_radius_);
+    void set_kill(int attacker, int defender, bool allowed);
+
+private:
+    bool parse(std::istream &is);
+    void reset();
+
+    std::vector<KindInfo> infos;
+    std::vector<int> steps;
+    std::vector<int> radii;
+    std::vector<Reach> reaches;
+    std::vector<char> glyphs;
+    std::vector<uint8_t> predators;
+    std::vector<uint64_t> prey_masks;
+    std::vector<uint8_t> kills;
+};
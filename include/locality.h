@@ -0,0 +1,19 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include "world.h"
+
+// Пространственная упорядоченность плотного массива мира. NPC, соседние на карте, полезно держать
+// рядом и в памяти: поиск сражений берёт из сетки плотные индексы соседей и читает их горячие записи.
+// Порядок задаёт кривая Z-порядка (Morton) по координатам.
+
+// Ключ Z-порядка: биты x и y через один (x - в младшем). Отрицательные координаты идут раньше положительных
+uint64_t morton_key(int32_t x, int32_t y);
+
+// Доля соседних пар плотного массива, идущих против кривой: 0 - массив упорядочен,
+// около 0.5 - порядок не связан с положением. Вызывающий держит read_lock() мира
+double morton_disorder(const World &world);
+
+// Плотные индексы в порядке кривой (при равных ключах - в прежнем порядке), для World::reorder().
+// Вызывающий держит read_lock() мира
+void morton_order(const World &world, std::vector<uint32_t> &order);
@@ -2,14 +2,43 @@
 #include <iostream>
 #include <memory>
 #include <vector>
-#include <shared_mutex>
+#include <span>
+#include <array>
+#include <atomic>
+#include <string_view>
+#include "text_buffer.h"
+#include "proximity.h"
 
 struct Dragon;
 struct Bull;
 struct Toad;
+struct Creature;
 
 using NPC_ptr = std::shared_ptr<struct NPC>;
 
+enum NpcKind { DragonType = 1, BullType = 2, ToadType = 3 };
+constexpr int MAX_NPC_KINDS = 64;
+
+// Счётчики живых NPC по видам. Ведутся инкрементально: World увеличивает при добавлении,
+// NPC::must_die() уменьшает, поэтому статистика не требует обхода мира.
+struct Population {
+    std::array<std::atomic<uint32_t>, MAX_NPC_KINDS> by_kind{};
+    std::atomic<uint32_t> total{0};
+};
+
+// Копия горячей части NPC в плотном массиве мира: всё, что читают циклы поиска пар, индексы и поля.
+// Владелец значений - объект NPC (он живёт и вне мира, например в BattleManager); запись в массиве -
+// зеркало для локальности, его пишут только NPC::move(), NPC::must_die() и NPC::bind(). Память она
+// не экономит, а добавляет 16 байт на NPC.
+struct PackedNpc {
+    int32_t x{0};
+    int32_t y{0};
+    uint8_t kind{0};
+    uint8_t alive{0};
+    uint16_t reserved{0};
+};
+static_assert(sizeof(PackedNpc) <= 16, "hot NPC record must stay within 16 bytes");
+
 struct IFightObserver{
     virtual void on_fight(const NPC_ptr &attacker, const NPC_ptr &defender, bool win) = 0;
     virtual ~IFightObserver() = default;
@@ -17,37 +46,89 @@ struct IFightObserver{
 
 struct NPC : public std::enable_shared_from_this<NPC> {
     public:
+        // Пустое имя у NPC из пакетной генерации: get_name() строит "<вид>_<serial>" при обращении
         std::string name;
         int x{0};
         int y{0};
+        uint32_t serial{0};
 
     protected:
-        bool alive{true};
-        mutable std::shared_mutex mtx_pos;
+        NpcKind kind_tag;
+        std::atomic<bool> alive{true};
+        // Счётчик-seqlock положения вместо std::shared_mutex (4 байта вместо 56): нечётный, пока
+        // move() или bind() пишут x, y; position() перечитывает пару, если счётчик сменился.
+        // Без отдельных барьеров (их не моделирует ThreadSanitizer): писатель пишет x, y release-записями
+        // после захвата счётчика, читатель берёт их acquire-чтениями до повторной проверки счётчика
+        mutable std::atomic<uint32_t> pos_seq{0};
+        Population *population{nullptr};
+        PackedNpc *hot{nullptr};
         std::vector<std::shared_ptr<IFightObserver>> observers;
 
+        void describe_as(TextBuffer &out, std::string_view label) const;
+        uint32_t lock_position();
+        void unlock_position(uint32_t seq) {pos_seq.store(seq + 2, std::memory_order_release);}
+
+        // Проверки близости читают координаты без pos_seq, параллельно с move() из других потоков.
+        // Атомарные relaxed-чтение и запись на x86 - обычные mov, но без гонки данных.
+        static int relaxed(const int &value) {
+            return std::atomic_ref<int>(const_cast<int &>(value)).load(std::memory_order_relaxed);
+        }
+        static void store_relaxed(int &target, int value) {
+            std::atomic_ref<int>(target).store(value, std::memory_order_relaxed);
+        }
+        static int load_acquire(const int &value) {
+            return std::atomic_ref<int>(const_cast<int &>(value)).load(std::memory_order_acquire);
+        }
+        static void store_release(int &target, int value) {
+            std::atomic_ref<int>(target).store(value, std::memory_order_release);
+        }
+
     public: 
-        NPC() = default;
-        NPC(const std::string &name_, int x_, int y_);
+        explicit NPC(NpcKind kind_);
+        NPC(NpcKind kind_, const std::string &name_, int x_, int y_);
         virtual ~NPC() = default;
 
         void subscribe(std::shared_ptr<IFightObserver> observer);
+        void unsubscribe_all();
         void fight_notify(const NPC_ptr &defender, bool win);
 
-        bool is_close(const NPC_ptr &other, size_t distance) const;
+        bool is_close(const NPC_ptr &other, size_t distance) const {return is_close(*other, distance);}
+        bool is_close(const NPC &other, size_t distance) const {return is_close(other, reach_of(clamp_radius(distance)));}
+        // Радиус с заранее посчитанным квадратом, например kill_reach() вида
+        bool is_close(const NPC &other, Reach reach) const {
+            return within_reach(relaxed(x), relaxed(y), relaxed(other.x), relaxed(other.y), reach);
+        }
+        size_t is_close(std::span<const NPC_ptr> others, size_t distance, std::vector<uint32_t> &hits) const;
         std::pair<int, int> position() const;
         void move(int dx, int dy, int max_x, int max_y);
         bool is_alive() const;
         void must_die();
+        // Вид хранится в самом объекте: классификация без RTTI и виртуального вызова
+        NpcKind kind() const {return kind_tag;}
+        std::string get_name() const;
+        // Имя прямо в буфер, без временной строки для NPC с ленивым именем
+        void write_name(TextBuffer &out) const;
+        // Привязка к счётчикам мира; живой NPC переносит свой вклад из старых счётчиков в новые
+        void track(Population *counters);
+        // Привязка к записи горячего массива мира (nullptr - отвязать); запись сразу заполняется
+        void bind(PackedNpc *slot);
+        // Оценка занимаемой памяти: объект с блоком shared_ptr, имя и список наблюдателей в куче
+        size_t footprint() const;
 
         virtual int step() const = 0;
         virtual int kill_radius() const = 0;
+        // Радиус убийства вида с квадратом из таблицы видов
+        Reach kill_reach() const;
 
         virtual bool accept(const NPC_ptr &attacker) = 0;
         virtual bool visit_dragon(const std::shared_ptr<Dragon> &defender) = 0;
         virtual bool visit_bull(const std::shared_ptr<Bull> &defender) = 0;
         virtual bool visit_toad(const std::shared_ptr<Toad> &defender) = 0;
-        virtual void print() const = 0;
+        virtual bool visit_creature(const std::shared_ptr<Creature> &defender) = 0;
+        // Строка "<вид>: { name: ..., x: ..., y: ... }" без перевода строки
+        virtual void describe(TextBuffer &out) const = 0;
+        // describe() одной записью в std::cout
+        void print() const;
         virtual void save(std::ostream &os) const;
         friend std::ostream &operator<<(std::ostream &os, const NPC &npc);
 };
\ No newline at end of file
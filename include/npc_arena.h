@@ -0,0 +1,65 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdlib>
+#include <memory>
+#include <vector>
+
+// Память под NPC, создаваемых пачкой (generate_world): объект вместе со счётчиками shared_ptr
+// нарезается подряд из блоков по BLOCK_BYTES (выровненных по размеру, под большие страницы),
+// а не отдельным malloc на каждого NPC.
+// Гибель одного NPC память не возвращает: блоки освобождаются разом, когда удалён последний
+// NPC арены и создатель её отпустил. Наполняет арену один поток, удалять NPC можно из любого.
+class NpcArena {
+public:
+    static constexpr size_t BLOCK_BYTES = size_t{2} << 20;
+
+    struct Release {
+        void operator()(NpcArena *arena) const {arena->release();}
+    };
+    using Owner = std::unique_ptr<NpcArena, Release>;
+    // Ссылка создателя; NPC держат арену сами, пока живы
+    static Owner make() {return Owner(new NpcArena());}
+
+    NpcArena(const NpcArena &) = delete;
+    NpcArena &operator=(const NpcArena &) = delete;
+
+    void *allocate(size_t bytes, size_t align);
+    void retain() {refs.fetch_add(1, std::memory_order_relaxed);}
+    void release();
+    size_t blocks() const {return storage.size();}
+
+private:
+    NpcArena() = default;
+    ~NpcArena() = default;
+
+    struct Free {
+        void operator()(std::byte *block) const {std::free(block);}
+    };
+
+    std::vector<std::unique_ptr<std::byte, Free>> storage;
+    size_t used{BLOCK_BYTES};
+    std::atomic<size_t> refs{1};
+};
+
+// Распределитель для std::allocate_shared: каждая выделенная область держит ссылку на арену
+template <class T>
+struct ArenaAllocator {
+    using value_type = T;
+
+    NpcArena *arena;
+
+    explicit ArenaAllocator(NpcArena &arena_) : arena(&arena_) {}
+    template <class U>
+    ArenaAllocator(const ArenaAllocator<U> &other) : arena(other.arena) {}
+
+    T *allocate(size_t count) {
+        void *memory = arena->allocate(count * sizeof(T), alignof(T));
+        arena->retain();
+        return static_cast<T *>(memory);
+    }
+    void deallocate(T *, size_t) {arena->release();}
+
+    template <class U>
+    friend bool operator==(const ArenaAllocator &a, const ArenaAllocator<U> &b) {return a.arena == b.arena;}
+};
@@ -1,7 +1,10 @@
 #pragma once
-#include <fstream>
+#include <string>
 #include "npc.h"
+#include "event_log.h"
 
+// Наблюдатели сообщают об убийствах записями LogRecord::Murder: TextObserver - в console_log(),
+// FileObserver - в log.txt (или файл set_path). Текст строится, только если приёмник включён.
 struct TextObserver : public IFightObserver {
 
 public:
@@ -16,9 +19,14 @@ struct FileObserver : public IFightObserver {
 
 public:
     static std::shared_ptr<IFightObserver> get();
+    // Файл журнала вместо log.txt; действует, если вызван до первого get()
+    static void set_path(std::string path);
     void on_fight(const NPC_ptr &attacker, const NPC_ptr &defender, bool win) override;
+    LogSink &sink() {return log;}
 
 private:
-    std::ofstream logfile;
+    static std::string &log_path();
+
+    FileSink log;
     FileObserver();
 };
@@ -0,0 +1,48 @@
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+
+constexpr int64_t squared(int64_t v) {return v * v;}
+
+// Радиус, при котором квадрат радиуса и квадраты разностей координат помещаются в 64 бита
+constexpr int64_t MAX_RADIUS = std::numeric_limits<int32_t>::max();
+
+constexpr int64_t clamp_radius(size_t distance) {
+    return static_cast<int64_t>(std::min<uint64_t>(distance, MAX_RADIUS));
+}
+
+// Радиус проверки (не больше MAX_RADIUS, -1 - никого) и его квадрат. Считаются один раз: для видов -
+// заранее в KindRegistry::kill_reach, для произвольного расстояния - reach_of перед циклом
+struct Reach {
+    int64_t radius;
+    int64_t radius_sq;
+};
+
+constexpr Reach reach_of(int64_t radius) {
+    radius = std::min(radius, MAX_RADIUS);
+    return radius < 0 ? Reach{-1, -1} : Reach{radius, squared(radius)};
+}
+
+// Целочисленная проверка расстояния. Сначала отсев по ограничивающему квадрату: далёкие пары (почти все
+// при переборе) отбрасываются одним сравнением по оси x. После отсева |dx|, |dy| <= MAX_RADIUS, и сумма
+// квадратов (меньше 2^63) точно считается в int64
+constexpr bool within_reach(int ax, int ay, int bx, int by, Reach reach) {
+    int64_t dx = static_cast<int64_t>(ax) - bx;
+    int64_t dy = static_cast<int64_t>(ay) - by;
+    auto span = static_cast<uint64_t>(2 * reach.radius);
+    if ((static_cast<uint64_t>(dx + reach.radius) > span) | (static_cast<uint64_t>(dy + reach.radius) > span)) {
+        return false;
+    }
+    return dx * dx + dy * dy <= reach.radius_sq;
+}
+
+constexpr bool within_radius(int ax, int ay, int bx, int by, int64_t radius) {
+    return within_reach(ax, ay, bx, by, reach_of(radius));
+}
+
+static_assert(reach_of(30).radius_sq == 900 && reach_of(-5).radius == -1);
+static_assert(within_radius(0, 0, 6, 8, 10) && !within_radius(0, 0, 6, 8, 9));
+static_assert(!within_radius(-2000000000, -2000000000, 2000000000, 2000000000, MAX_RADIUS));
+static_assert(within_radius(-2000000000, 0, 147483647, 0, MAX_RADIUS));
@@ -0,0 +1,56 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Карта в терминале: кадр собирается в один заранее выделенный буфер,
+// выводятся только изменившиеся клетки (адресация курсора ANSI) одним write().
+// Карта занимает верхние строки экрана, ниже идут строки статуса,
+// а остальной текст программы прокручивается в области под ними.
+class MapRenderer {
+public:
+    MapRenderer(int cols_, int rows_, int status_lines_ = 3);
+
+    // Область мира, отображаемая на карту (масштаб и сдвиг)
+    void set_viewport(int x0, int y0, int width, int height);
+    // Режим плотности: в клетке число NPC (1-9, '+' если больше) вместо символа вида
+    void set_density(bool on) {density = on;}
+
+    void begin_frame();
+    void plot(int x, int y, char glyph);
+    void set_status(int line, std::string_view text);
+
+    std::string_view compose();
+    void present(int fd = 1);
+    // Следующий кадр будет перерисован целиком
+    void invalidate() {full_redraw = true;}
+    // Снимает область прокрутки и ставит курсор под карту
+    std::string_view finish();
+
+    int cols() const {return cols_n;}
+    int rows() const {return rows_n;}
+    uint32_t count_at(int col, int row) const {return counts[row * cols_n + col];}
+
+private:
+    char cell_char(size_t cell) const;
+    void move_to(int row, int col);
+
+    int cols_n;
+    int rows_n;
+    int view_x{0};
+    int view_y{0};
+    int view_w{1};
+    int view_h{1};
+    bool density{false};
+    bool full_redraw{true};
+
+    std::vector<uint32_t> counts;
+    std::vector<char> glyphs;
+    std::vector<char> shown;
+    std::vector<std::string> status;
+    std::vector<std::string> shown_status;
+    std::string out;
+    int cursor_row{-1};
+    int cursor_col{-1};
+};
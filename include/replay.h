@@ -0,0 +1,60 @@
+#pragma once
+#include <cstdint>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <vector>
+#include "checkpoint.h"
+#include "simulation.h"
+
+// Запись прогона для повторения: мир и состояние генераторов на начало записи
+// и точки разбора сражений. Перемещение при заданном начальном состоянии детерминировано,
+// непредсказуемо только то, когда поток сражений забирает очередь, - это и записывается.
+struct FightTrace {
+    // Один вызов Simulation::resolve: после какого тика, сколько пар из очереди забрано, сколько убито
+    struct Resolve {
+        uint64_t tick;
+        uint32_t events;
+        uint32_t kills;
+    };
+
+    WorldSnapshot start;
+    bool flow{false};
+    uint64_t end_tick{0};
+    std::vector<Resolve> resolves;
+};
+
+// Формат: "NPCTRCE1", флаг полей направлений, последний тик, снимок (формат checkpoint), точки разбора
+void write_trace(std::ostream &os, const FightTrace &trace);
+bool read_trace(std::istream &is, FightTrace &trace);
+
+struct ReplayResult {
+    uint64_t ticks{0};
+    size_t resolves{0};
+    size_t kills{0};
+    // Первый разбор, где число убитых разошлось с записью (тик), - дальше повтор уже не тот прогон
+    bool diverged{false};
+    uint64_t divergence_tick{0};
+    double seconds{0};
+};
+
+// Повтор записанного прогона в одном потоке, без пауз и отрисовки: тики идут подряд,
+// очередь пар разбирается ровно в тех точках, где это сделал поток сражений при записи.
+class Replay {
+public:
+    explicit Replay(const FightTrace &trace_, const KindRegistry &registry = KindRegistry::instance());
+
+    bool valid() const {return sim != nullptr;}
+    // Повторяет до тика until (включая разборы после него) или до конца записи
+    ReplayResult run(uint64_t until = std::numeric_limits<uint64_t>::max());
+    // Состояние после run(): для снимка, профилирования или продолжения вручную
+    Simulation &simulation() {return *sim;}
+
+private:
+    const FightTrace &trace;
+    std::unique_ptr<Simulation> sim;
+    size_t next_resolve{0};
+    std::vector<FightEvent> queue;
+    std::vector<FightEvent> batch;
+    ReplayResult result;
+};
@@ -0,0 +1,191 @@
+#pragma once
+#include <coroutine>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <utility>
+#include <vector>
+
+class Scheduler;
+
+// Кадры корутин одного размера (первого запрошенного) из блоков по FRAMES_PER_SLAB штук; освобождённые
+// кадры идут в односвязный список и берутся первыми. Вместо 10^6 вызовов malloc при создании мира -
+// сотни блоков. Не потокобезопасен, как и Scheduler, которому принадлежит
+class FramePool {
+public:
+    static constexpr size_t FRAMES_PER_SLAB = 4096;
+
+    // Пока жив Scope, кадры корутин, создаваемых на этом потоке, берутся из pool
+    class Scope {
+    public:
+        explicit Scope(FramePool &pool);
+        ~Scope();
+        Scope(const Scope &) = delete;
+        Scope &operator=(const Scope &) = delete;
+
+    private:
+        FramePool *previous;
+    };
+    // Пул ближайшего Scope этого потока, nullptr - кадры из обычной кучи
+    static FramePool *current();
+
+    FramePool() = default;
+    FramePool(const FramePool &) = delete;
+    FramePool &operator=(const FramePool &) = delete;
+
+    // nullptr - размер не тот, кадр надо взять обычным operator new
+    void *allocate(size_t size);
+    void release(void *frame);
+    size_t slabs() const {return blocks.size();}
+    // Память блоков вместе со свободными кадрами
+    size_t bytes() const {return blocks.size() * FRAMES_PER_SLAB * frame_size;}
+
+private:
+    struct FreeFrame {
+        FreeFrame *next;
+    };
+
+    size_t frame_size{0};
+    FreeFrame *free_frames{nullptr};
+    size_t slab_used{FRAMES_PER_SLAB};
+    std::vector<std::unique_ptr<std::byte[]>> blocks;
+};
+
+// Поведение NPC - корутина, которую возобновляет Scheduler.
+// Внутри можно ждать тиков (wait_ticks), условия (wait_until) или события (Event).
+struct Behaviour {
+    struct promise_type {
+        Scheduler *scheduler{nullptr};
+        size_t live_index{0};
+        uint64_t tag{0};
+
+        Behaviour get_return_object() {
+            return Behaviour{std::coroutine_handle<promise_type>::from_promise(*this)};
+        }
+        std::suspend_always initial_suspend() noexcept {return {};}
+        std::suspend_always final_suspend() noexcept {return {};}
+        void return_void() {}
+        void unhandled_exception() {throw;}
+
+        // Кадр - из FramePool::current() или из кучи; перед кадром заголовок с пулом, из которого он
+        // взят, и delete возвращает кадр туда же
+        static void *operator new(size_t size);
+        static void operator delete(void *frame, size_t size);
+
+    private:
+        static constexpr size_t FRAME_HEADER = __STDCPP_DEFAULT_NEW_ALIGNMENT__;
+    };
+    using Handle = std::coroutine_handle<promise_type>;
+
+    Behaviour() = default;
+    explicit Behaviour(Handle h) : handle(h) {}
+    Behaviour(Behaviour &&other) noexcept : handle(std::exchange(other.handle, {})) {}
+    Behaviour &operator=(Behaviour &&other) noexcept;
+    Behaviour(const Behaviour &) = delete;
+    Behaviour &operator=(const Behaviour &) = delete;
+    ~Behaviour();
+
+    Handle release() {return std::exchange(handle, {});}
+
+private:
+    Handle handle;
+};
+
+// Планировщик на колесе таймеров: за тик обходится только корзина текущего тика,
+// поэтому стоимость тика пропорциональна числу проснувшихся корутин, а не всех NPC.
+class Scheduler {
+public:
+    static constexpr uint32_t WHEEL_SIZE = 256;
+
+    Scheduler();
+    ~Scheduler();
+    Scheduler(const Scheduler &) = delete;
+    Scheduler &operator=(const Scheduler &) = delete;
+
+    // Корутина начнёт выполняться через delay тиков (0 - на ближайшем tick()); tag - произвольная метка владельца
+    void spawn(Behaviour behaviour, uint64_t tag = 0, uint64_t delay = 0);
+    // Место под ещё count корутин перед пакетным spawn
+    void reserve(size_t count);
+    size_t tick();
+
+    struct Wakeup {
+        uint64_t tag;
+        // Через сколько tick() корутина проснётся: 0 - на следующем
+        uint64_t delay;
+    };
+    // Все корутины в колесе в порядке возобновления: по тику пробуждения, внутри тика - по очереди
+    // в корзине. Корутины, ждущие Event, сюда не попадают
+    void pending(std::vector<Wakeup> &wakeups) const;
+
+    uint64_t now() const {return current;}
+    size_t active() const {return live.size();}
+    FramePool &frame_pool() {return frames;}
+    const FramePool &frame_pool() const {return frames;}
+    // Колесо, условия wait_until и список живых корутин, без кадров (они в frame_pool())
+    size_t memory_bytes() const;
+
+    void schedule(Behaviour::Handle h, uint64_t ticks, std::function<bool()> condition = {}, uint32_t poll_every = 1);
+
+private:
+    static constexpr uint32_t NO_CONDITION = ~uint32_t{0};
+
+    // Условия wait_until лежат отдельно: запись колеса для wait_ticks остаётся 24 байтами
+    struct Entry {
+        Behaviour::Handle handle;
+        uint64_t due;
+        uint32_t condition;
+        uint32_t poll_every;
+    };
+
+    void enqueue(Behaviour::Handle h, uint64_t ticks, uint32_t condition, uint32_t poll_every);
+    void finish(Behaviour::Handle h);
+
+    std::vector<std::vector<Entry>> wheel;
+    std::vector<std::function<bool()>> conditions;
+    std::vector<uint32_t> free_conditions;
+    std::vector<Entry> due_now;
+    std::vector<Behaviour::Handle> live;
+    uint64_t current{0};
+    // Объявлен последним: кадры живых корутин уничтожаются в ~Scheduler() до пула
+    FramePool frames;
+};
+
+struct WaitTicks {
+    uint32_t ticks;
+
+    bool await_ready() const noexcept {return ticks == 0;}
+    void await_suspend(Behaviour::Handle h) const {h.promise().scheduler->schedule(h, ticks);}
+    void await_resume() const noexcept {}
+};
+
+struct WaitUntil {
+    std::function<bool()> condition;
+    uint32_t poll_every;
+
+    bool await_ready() const {return condition();}
+    void await_suspend(Behaviour::Handle h) {h.promise().scheduler->schedule(h, poll_every, std::move(condition), poll_every);}
+    void await_resume() const noexcept {}
+};
+
+inline WaitTicks wait_ticks(uint32_t ticks) {return WaitTicks{ticks};}
+
+// Условие (например, близость противника) проверяется раз в poll_every тиков
+inline WaitUntil wait_until(std::function<bool()> condition, uint32_t poll_every = 1) {
+    return WaitUntil{std::move(condition), poll_every};
+}
+
+// Одноразовое событие: ожидающие корутины просыпаются на ближайшем tick() после signal()
+class Event {
+public:
+    void signal();
+    bool signalled() const {return fired;}
+
+    bool await_ready() const noexcept {return fired;}
+    void await_suspend(Behaviour::Handle h) {waiters.push_back(h);}
+    void await_resume() const noexcept {}
+
+private:
+    std::vector<Behaviour::Handle> waiters;
+    bool fired{false};
+};
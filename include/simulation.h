@@ -0,0 +1,164 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <vector>
+#include "world.h"
+#include "scheduler.h"
+#include "checkpoint.h"
+#include "kind_registry.h"
+#include "spatial_index.h"
+#include "flow_field.h"
+#include "tick_clock.h"
+#include "dice.h"
+#include "event_log.h"
+
+struct FightTrace;
+class FightManager;
+
+// Пара для разбора и её броски: кости бросаются при поиске пар, по (seed, тик, номер пары в тике)
+struct FightEvent {
+    EntityId attacker;
+    EntityId defender;
+    uint8_t attack{0};
+    uint8_t defense{0};
+};
+
+// Состояние игры и один тик: перемещение, поиск сражений, их разбор.
+// В main перемещение и разбор идут в разных потоках (move_tick и resolve),
+// tick() выполняет их последовательно - такой прогон детерминирован при заданном seed.
+class Simulation {
+public:
+    Simulation(int width, int height, uint32_t seed, const KindRegistry &registry = KindRegistry::instance());
+    Simulation(const Simulation &) = delete;
+    Simulation &operator=(const Simulation &) = delete;
+
+    EntityId spawn(NPC_ptr npc);
+    void spawn(std::span<const NPC_ptr> batch);
+
+    void move_tick(std::vector<FightEvent> &events);
+    size_t resolve(const std::vector<FightEvent> &events);
+    // Разбор очереди потока сражений: пары забираются из queue в batch под тем же замком, что берёт
+    // capture(), поэтому снимок видит каждую пару либо в очереди, либо уже разобранной
+    size_t resolve(FightManager &queue, std::vector<FightEvent> &batch);
+    size_t tick();
+
+    World &world() {return world_;}
+    const World &world() const {return world_;}
+    uint64_t ticks() const {return tick_count;}
+    const KindRegistry &kinds() const {return registry;}
+    int max_x() const {return max_x_;}
+    int max_y() const {return max_y_;}
+    // Индекс по положениям после последнего move_tick; запросы - под read_lock() мира
+    const SpatialIndex &spatial() const {return index;}
+    // Режим движения по полям направлений: хищники идут к жертвам, жертвы убегают.
+    // Переключается между тиками; nullptr - случайное блуждание
+    void set_flow(bool on) {flow_mode = on;}
+    // Потоки перестройки полей каждый тик (FlowField::rebuild): 0 - по числу ядер. Пакетный прогон,
+    // где миры и так идут параллельно, ставит 1
+    void set_flow_threads(unsigned threads) {flow_threads = threads;}
+    const FlowField *flow_field() const {return flow_mode ? &flow : nullptr;}
+
+    // Засыпание перемещения. Вид, у которого в мире не осталось ни жертв, ни угроз, стоит и ждёт их
+    // появления (проверка раз в IDLE_POLL_TICKS тиков). При случайном блуждании NPC, до которого никто
+    // из них не дойдёт за несколько тиков, спит эти тики (не больше MAX_IDLE_TICKS). Поиск сражений
+    // проверяет всех NPC независимо от сна
+    static constexpr uint32_t IDLE_POLL_TICKS = 16;
+    static constexpr uint32_t MAX_IDLE_TICKS = 8;
+    bool has_counterparts(int kind) const;
+    // Сколько тиков NPC вида kind в (x, y) может простоять, 0 - двигаться сейчас
+    uint32_t idle_ticks(int x, int y, int kind) const;
+    // Сколько корутин перемещения возобновил последний move_tick
+    size_t resumed() const {return last_resumed;}
+    // Пул кадров корутин перемещения: spawn и restore создают их под FramePool::Scope этого пула
+    FramePool &frame_pool() {return scheduler.frame_pool();}
+    // Память мира вместе с кадрами корутин и планировщиком; под read_lock() мира, между тиками
+    MemoryReport memory_report() const;
+
+    bool print_kills{true};
+    // Вместо строки на каждое убийство - одна строка-итог (LogRecord::Summary) на разбор
+    bool summarize_kills{false};
+
+    // Раз в REORDER_CHECK_TICKS тиков плотный массив мира сортируется по кривой Z-порядка положений,
+    // если доля пар не по порядку (morton_disorder) больше порога; 0 - не сортировать
+    static constexpr uint64_t REORDER_CHECK_TICKS = 32;
+    void set_reorder_threshold(double threshold) {reorder_threshold = threshold;}
+    size_t reorders() const {return reorder_count;}
+
+    // Снимок берётся между тиками потока перемещения, после передачи пар тика в queue; буферы snapshot
+    // переиспользуются. Под замками копируются только числа, имена пишет Checkpointer на своём потоке.
+    // В снимок попадают и пары, ещё не разобранные потоком сражений (queue, если он есть)
+    void capture(WorldSnapshot &snapshot, const FightManager *queue = nullptr) const;
+    // Таблица видов registry должна совпадать с таблицей снимка (KindRegistry::load_table)
+    static std::unique_ptr<Simulation> restore(const WorldSnapshot &snapshot,
+                                               const KindRegistry &registry = KindRegistry::instance());
+    // Неразобранные пары из снимка: их надо передать потоку сражений; tick() разбирает их сам
+    void take_restored_fights(std::vector<FightEvent> &out);
+
+    // Запись прогона для Replay: снимок на начало и каждый resolve. Пока запись идёт, move_tick
+    // и resolve не пересекаются, иначе гибель NPC посреди тика не повторить. Включается и
+    // выключается (nullptr, trace->end_tick заполняется), когда потоки перемещения и сражений стоят
+    void record(FightTrace *trace_);
+
+private:
+    void rebuild_presence();
+    size_t resolve_locked(const std::vector<FightEvent> &events);
+
+    const KindRegistry &registry;
+    World world_;
+    SpatialIndex index;
+    FlowField flow;
+    bool flow_mode{false};
+    unsigned flow_threads{0};
+    double reorder_threshold{0.25};
+    size_t reorder_count{0};
+    std::vector<uint32_t> order;
+    Scheduler scheduler;
+    size_t last_resumed{0};
+    // По виду: маска видов его жертв и угроз, сближение с ними за тик и наибольший радиус броска
+    std::vector<uint64_t> counterparts;
+    std::vector<int> approach;
+    std::vector<int> reach;
+    // Маски видов живых NPC по клеткам на начало тика (только при случайном блуждании)
+    int presence_cell{1};
+    int presence_cols{0};
+    int presence_rows{0};
+    std::vector<uint64_t> presence;
+    int max_x_;
+    int max_y_;
+    uint64_t tick_count{0};
+    std::mt19937 move_rng;
+    CounterDice dice;
+    mutable std::mutex fight_mtx;
+    std::vector<FightEvent> pending;
+    std::vector<FightEvent> restored_fights;
+    std::vector<uint32_t> hits;
+    std::vector<uint8_t> attack_rolls;
+    std::vector<uint8_t> defense_rolls;
+    KillTally tally;
+    FightTrace *trace{nullptr};
+};
+
+// Поток разбора сражений: забирает накопленные потоком перемещения пары и вызывает Simulation::resolve
+// с частотой rate_hz. Завершается, когда running сброшен и очередь пуста.
+class FightManager {
+public:
+    FightManager(Simulation &sim_, std::atomic_bool &flag, double rate_hz = 100.0)
+        : sim(sim_), running(flag), pace(rate_hz) {}
+
+    void add_events(std::vector<FightEvent> &batch);
+    // Забрать всю очередь в batch / дописать её копию в out
+    void take(std::vector<FightEvent> &batch);
+    void queued(std::vector<FightEvent> &out) const;
+    void operator()();
+    const TickClock &clock() const {return pace;}
+
+private:
+    std::vector<FightEvent> events;
+    mutable std::mutex mtx;
+    Simulation &sim;
+    std::atomic_bool &running;
+    TickClock pace;
+};
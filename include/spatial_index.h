@@ -0,0 +1,58 @@
+#pragma once
+#include <cstdint>
+#include <limits>
+#include <vector>
+#include "world.h"
+#include "kind_registry.h"
+
+// Пространственный индекс живых NPC мира: равномерная сетка, перестраиваемая каждый тик
+// подсчётом по клеткам (O(n)). Записи клетки лежат подряд, в порядке плотных индексов мира.
+// Запросы возвращают плотные индексы World (действительны до следующего изменения мира)
+// и принимают маску видов: бит k - вид k проходит фильтр. prey_mask() даёт маску жертв по матрице видов.
+class SpatialIndex {
+public:
+    static constexpr uint64_t ANY_KIND = ~uint64_t{0};
+    static constexpr uint32_t NONE = std::numeric_limits<uint32_t>::max();
+
+    explicit SpatialIndex(const KindRegistry &registry_ = KindRegistry::instance()) : registry(registry_) {}
+
+    // Вызывающий держит read_lock() мира; cell_size 0 - наибольший радиус убийства среди видов
+    void rebuild(const World &world, int cell_size = 0);
+
+    size_t size() const {return xs.size();}
+    int cell_size() const {return cell;}
+    uint64_t prey_mask(int attacker_kind) const {return registry.prey_mask(attacker_kind);}
+
+    // Все в круге радиуса radius вокруг (x, y), включая границу
+    void radius(int x, int y, int64_t radius, std::vector<uint32_t> &out,
+                uint64_t kinds = ANY_KIND, uint32_t exclude = NONE) const;
+    // Все в прямоугольнике [x0, x1] x [y0, y1]
+    void rect(int x0, int y0, int x1, int y1, std::vector<uint32_t> &out, uint64_t kinds = ANY_KIND) const;
+    // До k ближайших в пределах max_radius, по возрастанию расстояния (при равенстве - по индексу)
+    void nearest(int x, int y, size_t k, std::vector<uint32_t> &out, uint64_t kinds = ANY_KIND,
+                 uint32_t exclude = NONE, int64_t max_radius = std::numeric_limits<int32_t>::max()) const;
+
+    // Ближайшие жертвы NPC с плотным индексом i: фильтр по матрице видов, сам NPC исключён
+    void nearest_prey(const World &world, size_t i, size_t k, std::vector<uint32_t> &out) const;
+
+private:
+    int cell_x(int x) const;
+    int cell_y(int y) const;
+    template <typename Visit>
+    void scan(int cx0, int cy0, int cx1, int cy1, uint64_t kinds, Visit &&visit) const;
+
+    const KindRegistry &registry;
+    int cell{1};
+    int origin_x{0};
+    int origin_y{0};
+    int cols{0};
+    int rows{0};
+    std::vector<uint32_t> cell_start;
+    // Клетка по плотному индексу мира
+    std::vector<uint32_t> cell_of;
+    std::vector<int> xs;
+    std::vector<int> ys;
+    std::vector<uint32_t> ids;
+    std::vector<uint8_t> kind_of;
+    uint64_t present{0};
+};
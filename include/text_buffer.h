@@ -0,0 +1,36 @@
+#pragma once
+#include <charconv>
+#include <concepts>
+#include <string>
+#include <string_view>
+
+// Сборка строки без iostream: текст дописывается в буфер, числа - через std::to_chars.
+// local() - буфер текущего потока, его память переиспользуется от сообщения к сообщению.
+class TextBuffer {
+public:
+    TextBuffer &operator<<(std::string_view s) {
+        data.append(s);
+        return *this;
+    }
+    TextBuffer &operator<<(char c) {
+        data.push_back(c);
+        return *this;
+    }
+    // uint8_t тоже выводится числом
+    template <std::integral T>
+    TextBuffer &operator<<(T value) {
+        char digits[24];
+        auto result = std::to_chars(digits, digits + sizeof(digits), value);
+        data.append(digits, result.ptr);
+        return *this;
+    }
+
+    std::string_view view() const {return data;}
+    size_t size() const {return data.size();}
+    void clear() {data.clear();}
+
+    static TextBuffer &local();
+
+private:
+    std::string data;
+};
@@ -0,0 +1,50 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <iosfwd>
+#include <mutex>
+
+// Темп цикла с заданной частотой. Поток вызывает wait() в конце каждого тика: часы меряют,
+// сколько занял тик, и спят только до дедлайна следующего. Если тик не уложился в бюджет,
+// сна нет; если отставание больше целого тика, пропущенные тики не догоняются пачкой -
+// дедлайны сдвигаются от текущего момента, а пропуск учитывается в статистике.
+class TickClock {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    struct Stats {
+        uint64_t ticks{0};
+        uint64_t overruns{0};
+        uint64_t skipped{0};
+        double work_ms_total{0};
+        double work_ms_max{0};
+        // Отклонение фактического начала тика от дедлайна
+        double jitter_ms_total{0};
+        double jitter_ms_max{0};
+    };
+
+    explicit TickClock(double rate_hz = 100.0);
+
+    void set_rate(double rate_hz);
+    double rate() const {return 1.0 / std::chrono::duration<double>(period).count();}
+    // Отсчёт с текущего момента; вызывается перед первым тиком (иначе - при первом wait())
+    void start();
+    // Конец тика. false - тик не уложился в бюджет
+    bool wait();
+    // Последний тик превысил бюджет: можно пропустить необязательную работу (отрисовку).
+    // Читается из других потоков
+    bool overloaded() const {return behind.load(std::memory_order_relaxed);}
+    Stats stats() const;
+
+private:
+    Clock::duration period;
+    Clock::time_point tick_start;
+    Clock::time_point deadline;
+    bool started{false};
+    std::atomic<bool> behind{false};
+    Stats counters;
+    mutable std::mutex mtx;
+};
+
+std::ostream &operator<<(std::ostream &os, const TickClock::Stats &stats);
@@ -2,12 +2,19 @@
 #include <memory>
 #include <vector>
 #include <string>
+#include <cstdint>
 #include "npc.h"
 
 class BattleManager {
 public:
     static void battle(std::vector<std::shared_ptr<NPC>>& npcs, size_t distance);
-    
+    static void mass_battle(std::vector<std::shared_ptr<NPC>>& npcs, size_t distance, unsigned threads = 0);
+
+    // Разбор сражений для фиксированного порядка npcs без перемешивания; результат - флаги гибели по индексам
+    static std::vector<bool> resolve(const std::vector<std::shared_ptr<NPC>>& npcs, size_t distance, bool verbose = false);
+    static std::vector<bool> resolve_parallel(const std::vector<std::shared_ptr<NPC>>& npcs, size_t distance, unsigned threads = 0);
+
 private:
-    static void process_fight(std::shared_ptr<NPC> attacker, std::shared_ptr<NPC> defender);
-};
\ No newline at end of file
+    static void process_fight(const std::shared_ptr<NPC> &first, const std::shared_ptr<NPC> &second,
+                              uint8_t &first_dead, uint8_t &second_dead, bool verbose);
+};
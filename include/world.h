@@ -0,0 +1,110 @@
+#pragma once
+#include <cstdint>
+#include <iosfwd>
+#include <vector>
+#include <span>
+#include <mutex>
+#include <shared_mutex>
+#include "npc.h"
+
+// Поколенческий идентификатор NPC: индекс слота + номер поколения.
+// После освобождения слота поколение увеличивается, и старые id перестают находиться.
+struct EntityId {
+    static constexpr uint32_t invalid_index = UINT32_MAX;
+
+    uint32_t index{invalid_index};
+    uint32_t generation{0};
+
+    bool valid() const {return index != invalid_index;}
+    friend bool operator==(const EntityId &a, const EntityId &b) = default;
+};
+
+// Оценка памяти мира. Горячий массив - то, что читают циклы каждого тика;
+// объекты - холодная часть NPC (объект, имя, наблюдатели); служебное - слоты и указатели.
+// Корутины и планировщик заполняет только Simulation::memory_report(): блоки пула кадров
+// и колесо таймеров с условиями и списком живых корутин.
+struct MemoryReport {
+    size_t npcs{0};
+    size_t hot_bytes{0};
+    size_t object_bytes{0};
+    size_t bookkeeping_bytes{0};
+    size_t coroutine_bytes{0};
+    size_t scheduler_bytes{0};
+    size_t resident_bytes{0};
+
+    size_t total_bytes() const {
+        return hot_bytes + object_bytes + bookkeeping_bytes + coroutine_bytes + scheduler_bytes;
+    }
+    double hot_per_npc() const {return npcs ? double(hot_bytes) / npcs : 0.0;}
+    double bytes_per_npc() const {return npcs ? double(total_bytes()) / npcs : 0.0;}
+    // Оценка для мира из count NPC при том же среднем размере
+    double projected_bytes(size_t count) const {return bytes_per_npc() * count;}
+};
+
+std::ostream &operator<<(std::ostream &os, const MemoryReport &report);
+// Резидентная память процесса (Linux, /proc/self/statm); 0, если недоступно
+size_t resident_bytes();
+
+// Контейнер мира: разреженный массив слотов + плотные массивы NPC и их горячих записей.
+// Изменяющие методы берут эксклюзивную блокировку сами; для чтения
+// (get, at, id_at, size) вызывающий держит read_lock() на всю пачку операций.
+// Счётчики живых по видам (population, alive) читаются без блокировки.
+class World {
+public:
+    World() = default;
+    World(const World &) = delete;
+    World &operator=(const World &) = delete;
+    ~World();
+
+    EntityId spawn(NPC_ptr npc);
+    // Пачка NPC под одной блокировкой и с одним расширением массивов; id дописываются в ids
+    void spawn(std::span<const NPC_ptr> batch, std::vector<EntityId> &ids);
+    void release(EntityId id);
+    size_t collect();
+    // Перестановка плотного порядка: на место i встаёт NPC с прежним плотным индексом order[i].
+    // Id не меняются (меняется только их слот -> плотный индекс); order - перестановка 0..size()-1
+    void reorder(std::span<const uint32_t> order);
+
+    NPC *get(EntityId id) const;
+    const NPC_ptr &shared(EntityId id) const;
+    bool contains(EntityId id) const;
+    size_t index_of(EntityId id) const {return contains(id) ? slots[id.index].dense : SIZE_MAX;}
+
+    size_t size() const {return npcs.size();}
+    NPC *at(size_t i) const {return npcs[i].get();}
+    uint8_t kind_at(size_t i) const {return hot[i].kind;}
+    // Горячие записи в плотном порядке. x, y меняет поток, двигающий NPC, - он же их и читает;
+    // alive может сбросить поток сражений, поэтому из других потоков - только через alive_at()
+    const PackedNpc &hot_at(size_t i) const {return hot[i];}
+    std::span<const PackedNpc> hot_view() const {return hot;}
+    bool alive_at(size_t i) const {
+        return std::atomic_ref<uint8_t>(const_cast<uint8_t &>(hot[i].alive)).load(std::memory_order_relaxed);
+    }
+    const NPC_ptr &shared_at(size_t i) const {return npcs[i];}
+    std::span<const NPC_ptr> view() const {return npcs;}
+    EntityId id_at(size_t i) const {return {owners[i], slots[owners[i]].generation};}
+
+    uint32_t population(int kind) const {return counters.by_kind[kind].load(std::memory_order_relaxed);}
+    uint32_t alive() const {return counters.total.load(std::memory_order_relaxed);}
+    // Вызывающий держит read_lock()
+    MemoryReport memory_report() const;
+
+    std::shared_lock<std::shared_mutex> read_lock() const {return std::shared_lock(mtx);}
+
+private:
+    struct Slot {
+        uint32_t generation{0};
+        uint32_t dense{EntityId::invalid_index};
+    };
+
+    EntityId spawn_unlocked(NPC_ptr npc);
+    void release_unlocked(uint32_t index);
+
+    std::vector<Slot> slots;
+    std::vector<uint32_t> free_slots;
+    std::vector<NPC_ptr> npcs;
+    std::vector<PackedNpc> hot;
+    std::vector<uint32_t> owners;
+    Population counters;
+    mutable std::shared_mutex mtx;
+};
@@ -0,0 +1,26 @@
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include "npc.h"
+#include "simulation.h"
+
+// Параметры пакетной генерации мира
+struct WorldSpec {
+    size_t count{0};
+    // Веса видов по номеру вида ([0] не используется); пусто - все виды реестра поровну
+    std::vector<double> weights;
+    uint32_t seed{0};
+    // 0 - по числу ядер. Результат от числа потоков не зависит
+    unsigned threads{0};
+    // Наблюдатели, на которых подписывается каждый NPC; по умолчанию никого
+    std::vector<std::shared_ptr<IFightObserver>> observers;
+};
+
+// Заполняет мир симуляции count NPC со случайными видами и положениями в её поле.
+// Мир делится на куски фиксированного размера со своими генераторами (seed, номер куска),
+// куски создаются параллельно, затем добавляются в мир одной пачкой. NPC куска лежат подряд в его
+// арене (NpcArena): память куска освобождается, когда удалён последний его NPC. Имена не строятся:
+// у NPC остаётся номер, а "<вид>_<номер>" выдаёт NPC::get_name() при обращении.
+// Возвращает число добавленных NPC.
+size_t generate_world(Simulation &sim, const WorldSpec &spec);
@@ -0,0 +1,209 @@
+#include "batch.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <iomanip>
+#include <sstream>
+#include <thread>
+#include "simulation.h"
+#include "world_gen.h"
+
+namespace {
+    struct Variation {
+        int kind;
+        bool radius;
+        std::vector<int> values;
+    };
+
+    bool parse_variation(const KindRegistry &kinds, const std::string &text, Variation &out) {
+        size_t dot = text.find('.');
+        size_t eq = text.find('=', dot == std::string::npos ? 0 : dot);
+        if (dot == std::string::npos || eq == std::string::npos) {
+            std::cerr << "Expected KIND.step=V,... or KIND.radius=V,...: " << text << "\n";
+            return false;
+        }
+        out.kind = kinds.find(text.substr(0, dot));
+        std::string field = text.substr(dot + 1, eq - dot - 1);
+        if (!out.kind) {
+            std::cerr << "Unknown kind in variation: " << text.substr(0, dot) << "\n";
+            return false;
+        }
+        if (field != "step" && field != "radius") {
+            std::cerr << "Unknown parameter in variation: " << field << "\n";
+            return false;
+        }
+        out.radius = field == "radius";
+        std::istringstream values(text.substr(eq + 1));
+        for (std::string value; std::getline(values, value, ',');) {
+            char *end = nullptr;
+            long v = std::strtol(value.c_str(), &end, 10);
+            if (value.empty() || *end != '\0' || v < 0) {
+                std::cerr << "Invalid value in variation: " << value << "\n";
+                return false;
+            }
+            out.values.push_back(static_cast<int>(v));
+        }
+        if (out.values.empty()) {
+            std::cerr << "No values in variation: " << text << "\n";
+            return false;
+        }
+        return true;
+    }
+
+    // Есть ли ещё пара "хищник - живая жертва"; по счётчикам, без обхода мира
+    bool fights_possible(const World &world, const KindRegistry &kinds) {
+        uint64_t present = 0;
+        for (size_t k = 1; k < kinds.size(); ++k) {
+            if (world.population(static_cast<int>(k))) {
+                present |= uint64_t{1} << k;
+            }
+        }
+        for (size_t k = 1; k < kinds.size(); ++k) {
+            if ((present >> k & 1) && (kinds.prey_mask(static_cast<int>(k)) & present)) {
+                return true;
+            }
+        }
+        return false;
+    }
+}
+
+bool expand_configs(const KindRegistry &base, const std::vector<std::string> &vary, std::vector<BatchConfig> &configs) {
+    std::vector<Variation> variations(vary.size());
+    for (size_t v = 0; v < vary.size(); ++v) {
+        if (!parse_variation(base, vary[v], variations[v])) {
+            return false;
+        }
+    }
+    configs.assign(1, BatchConfig{"base", base});
+    for (auto &variation : variations) {
+        std::vector<BatchConfig> next;
+        for (auto &config : configs) {
+            for (int value : variation.values) {
+                BatchConfig c = config;
+                int kind = variation.kind;
+                c.kinds.set_params(kind, variation.radius ? c.kinds.step(kind) : value,
+                                   variation.radius ? value : c.kinds.kill_radius(kind));
+                std::string part = base.info(kind).name + (variation.radius ? ".radius=" : ".step=") + std::to_string(value);
+                c.label = c.label == "base" ? part : c.label + " " + part;
+                next.push_back(std::move(c));
+            }
+        }
+        configs = std::move(next);
+    }
+    return true;
+}
+
+std::vector<BatchRun> run_batch(const std::vector<BatchConfig> &configs, const BatchOptions &options) {
+    std::vector<BatchRun> runs(configs.size() * options.worlds);
+    std::atomic<size_t> next{0};
+    auto worker = [&]() {
+        for (size_t job = next++; job < runs.size(); job = next++) {
+            auto start = std::chrono::steady_clock::now();
+            BatchRun &run = runs[job];
+            run.config = job / options.worlds;
+            run.seed = options.seed + static_cast<uint32_t>(job % options.worlds);
+            const KindRegistry &kinds = configs[run.config].kinds;
+
+            Simulation sim(options.width, options.height, run.seed, kinds);
+            sim.print_kills = false;
+            sim.set_flow(options.flow);
+            sim.set_flow_threads(1);
+            WorldSpec spec;
+            spec.count = options.npcs;
+            spec.seed = run.seed;
+            spec.threads = 1;
+            generate_world(sim, spec);
+            while (sim.ticks() < options.ticks && fights_possible(sim.world(), kinds)) {
+                sim.tick();
+            }
+
+            run.ticks = sim.ticks();
+            run.survivors.assign(kinds.size(), 0);
+            for (size_t k = 1; k < kinds.size(); ++k) {
+                run.survivors[k] = sim.world().population(static_cast<int>(k));
+            }
+            run.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        }
+    };
+
+    unsigned threads = options.threads ? options.threads : std::max(1u, std::thread::hardware_concurrency());
+    threads = static_cast<unsigned>(std::min<size_t>(threads, std::max<size_t>(runs.size(), 1)));
+    std::vector<std::thread> pool;
+    for (unsigned t = 1; t < threads; ++t) {
+        pool.emplace_back(worker);
+    }
+    worker();
+    for (auto &t : pool) {
+        t.join();
+    }
+    return runs;
+}
+
+void write_csv(std::ostream &os, const std::vector<BatchConfig> &configs, const std::vector<BatchRun> &runs) {
+    if (configs.empty()) {
+        return;
+    }
+    const KindRegistry &kinds = configs.front().kinds;
+    os << "config,label,seed,ticks";
+    for (size_t k = 1; k < kinds.size(); ++k) {
+        os << "," << kinds.info(static_cast<int>(k)).name;
+    }
+    os << "\n";
+    for (auto &run : runs) {
+        os << run.config << "," << configs[run.config].label << "," << run.seed << "," << run.ticks;
+        for (size_t k = 1; k < run.survivors.size(); ++k) {
+            os << "," << run.survivors[k];
+        }
+        os << "\n";
+    }
+}
+
+void write_summary(std::ostream &os, const std::vector<BatchConfig> &configs, const std::vector<BatchRun> &runs) {
+    if (configs.empty()) {
+        return;
+    }
+    const KindRegistry &kinds = configs.front().kinds;
+    size_t label_width = 6;
+    for (auto &config : configs) {
+        label_width = std::max(label_width, config.label.size());
+    }
+    auto flags = os.flags();
+    auto precision = os.precision();
+    os << std::left << std::setw(static_cast<int>(label_width) + 2) << "config" << std::right << std::setw(6) << "runs"
+       << std::setw(10) << "ticks";
+    for (size_t k = 1; k < kinds.size(); ++k) {
+        os << std::setw(16) << kinds.info(static_cast<int>(k)).name;
+    }
+    os << "\n" << std::fixed << std::setprecision(1);
+
+    for (size_t c = 0; c < configs.size(); ++c) {
+        size_t count = 0;
+        double ticks = 0;
+        std::vector<double> sum(kinds.size(), 0.0), sum_sq(kinds.size(), 0.0);
+        for (auto &run : runs) {
+            if (run.config != c) {
+                continue;
+            }
+            ++count;
+            ticks += static_cast<double>(run.ticks);
+            for (size_t k = 1; k < run.survivors.size(); ++k) {
+                sum[k] += run.survivors[k];
+                sum_sq[k] += static_cast<double>(run.survivors[k]) * run.survivors[k];
+            }
+        }
+        double n = count ? static_cast<double>(count) : 1.0;
+        os << std::left << std::setw(static_cast<int>(label_width) + 2) << configs[c].label << std::right
+           << std::setw(6) << count << std::setw(10) << ticks / n;
+        for (size_t k = 1; k < kinds.size(); ++k) {
+            double mean = sum[k] / n;
+            double sd = std::sqrt(std::max(0.0, sum_sq[k] / n - mean * mean));
+            std::ostringstream cell;
+            cell << std::fixed << std::setprecision(1) << mean << " +-" << sd;
+            os << std::setw(16) << cell.str();
+        }
+        os << "\n";
+    }
+    os.flags(flags);
+    os.precision(precision);
+}
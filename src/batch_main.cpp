@@ -0,0 +1,70 @@
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "batch.h"
+#include "kind_registry.h"
+
+// Пакетный прогон миров без вывода: ./batch --worlds 100 --vary Dragon.step=20,30 --csv runs.csv
+int main(int argc, char **argv) {
+    BatchOptions options;
+    std::vector<std::string> vary;
+    std::string kinds_path;
+    std::string csv_path;
+    for (int a = 1; a < argc; ++a) {
+        std::string arg = argv[a];
+        if (arg == "--worlds" && a + 1 < argc) {
+            options.worlds = std::stoull(argv[++a]);
+        } else if (arg == "--npcs" && a + 1 < argc) {
+            options.npcs = std::stoull(argv[++a]);
+        } else if (arg == "--ticks" && a + 1 < argc) {
+            options.ticks = std::stoull(argv[++a]);
+        } else if (arg == "--map" && a + 2 < argc) {
+            options.width = std::stoi(argv[++a]);
+            options.height = std::stoi(argv[++a]);
+        } else if (arg == "--seed" && a + 1 < argc) {
+            options.seed = static_cast<uint32_t>(std::stoul(argv[++a]));
+        } else if (arg == "--threads" && a + 1 < argc) {
+            options.threads = static_cast<unsigned>(std::stoul(argv[++a]));
+        } else if (arg == "--flow") {
+            options.flow = true;
+        } else if (arg == "--kinds" && a + 1 < argc) {
+            kinds_path = argv[++a];
+        } else if (arg == "--vary" && a + 1 < argc) {
+            vary.push_back(argv[++a]);
+        } else if (arg == "--csv" && a + 1 < argc) {
+            csv_path = argv[++a];
+        } else {
+            std::cerr << "Usage: " << argv[0] << " [--worlds N] [--npcs N] [--ticks T] [--map W H] [--seed S]"
+                      << " [--threads K] [--flow] [--kinds FILE] [--vary KIND.step|radius=V1,V2,...]... [--csv FILE]\n";
+            return 1;
+        }
+    }
+
+    KindRegistry &kinds = KindRegistry::instance();
+    if (!kinds_path.empty() && !kinds.load_file(kinds_path)) {
+        return 1;
+    }
+    std::vector<BatchConfig> configs;
+    if (!expand_configs(kinds, vary, configs)) {
+        return 1;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector<BatchRun> runs = run_batch(configs, options);
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    write_summary(std::cout, configs, runs);
+    std::cout << runs.size() << " worlds (" << configs.size() << " configs x " << options.worlds << ") in "
+              << seconds << " s" << std::endl;
+    if (!csv_path.empty()) {
+        std::ofstream csv(csv_path);
+        write_csv(csv, configs, runs);
+        if (!csv) {
+            std::cerr << "Cannot write " << csv_path << "\n";
+            return 1;
+        }
+    }
+    return 0;
+}
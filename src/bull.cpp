@@ -1,9 +1,13 @@
 #include "bull.h"
 #include "factory.h"
+#include "creature.h"
+#include "kind_registry.h"
 
-Bull::Bull(const std::string &name_, int x_, int y_) : NPC(name_, x_, y_) {}
+Bull::Bull() : NPC(BullType) {}
 
-Bull::Bull(std::istream &is){
+Bull::Bull(const std::string &name_, int x_, int y_) : NPC(BullType, name_, x_, y_) {}
+
+Bull::Bull(std::istream &is) : NPC(BullType) {
     is >> name;
     is >> x >> y;
 }
@@ -12,11 +16,15 @@ bool Bull::accept(const NPC_ptr &attacker) {
     return attacker->visit_bull(std::static_pointer_cast<Bull>(shared_from_this()));
 }
 
-bool Bull::visit_dragon(const std::shared_ptr<Dragon> &defender){return false; }
-bool Bull::visit_bull(const std::shared_ptr<Bull> &defender){return false;}
-bool Bull::visit_toad(const std::shared_ptr<Toad> &defender){return true;}
+bool Bull::visit_dragon(const std::shared_ptr<Dragon> &){return KindRegistry::instance().can_kill(BullType, DragonType);}
+bool Bull::visit_bull(const std::shared_ptr<Bull> &){return KindRegistry::instance().can_kill(BullType, BullType);}
+bool Bull::visit_toad(const std::shared_ptr<Toad> &){return KindRegistry::instance().can_kill(BullType, ToadType);}
+bool Bull::visit_creature(const std::shared_ptr<Creature> &defender){return KindRegistry::instance().can_kill(BullType, defender->kind());}
+
+int Bull::step() const {return KindRegistry::instance().step(BullType);}
+int Bull::kill_radius() const {return KindRegistry::instance().kill_radius(BullType);}
 
-void Bull::print() const {std::cout << "Bull: " << *this << std::endl; }
+void Bull::describe(TextBuffer &out) const {describe_as(out, "Bull");}
 
 void Bull::save(std::ostream &os) const {
     os << BullType << std::endl;
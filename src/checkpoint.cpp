@@ -0,0 +1,238 @@
+#include "checkpoint.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+
+namespace {
+    constexpr char MAGIC[8] = {'N', 'P', 'C', 'C', 'K', 'P', 'T', '4'};
+
+    template <typename T>
+    void put(std::ostream &os, const T &value) {
+        os.write(reinterpret_cast<const char *>(&value), sizeof(T));
+    }
+
+    template <typename T>
+    bool get(std::istream &is, T &value) {
+        return static_cast<bool>(is.read(reinterpret_cast<char *>(&value), sizeof(T)));
+    }
+
+    void put_string(std::ostream &os, const std::string &s) {
+        put(os, static_cast<uint32_t>(s.size()));
+        os.write(s.data(), static_cast<std::streamsize>(s.size()));
+    }
+
+    bool get_string(std::istream &is, std::string &s) {
+        uint32_t size = 0;
+        if (!get(is, size)) {
+            return false;
+        }
+        s.resize(size);
+        return static_cast<bool>(is.read(s.data(), size));
+    }
+
+    template <typename T>
+    void put_array(std::ostream &os, const std::vector<T> &v) {
+        os.write(reinterpret_cast<const char *>(v.data()), static_cast<std::streamsize>(v.size() * sizeof(T)));
+    }
+
+    template <typename T>
+    bool get_array(std::istream &is, std::vector<T> &v, size_t count) {
+        v.resize(count);
+        return static_cast<bool>(is.read(reinterpret_cast<char *>(v.data()), static_cast<std::streamsize>(count * sizeof(T))));
+    }
+}
+
+void WorldSnapshot::clear() {
+    kinds.clear();
+    alive.clear();
+    xs.clear();
+    ys.clear();
+    serials.clear();
+    names.clear();
+    named.clear();
+    wake_order.clear();
+    wake_delay.clear();
+    fights.clear();
+    kind_table.clear();
+    kind_prey.clear();
+}
+
+std::string_view WorldSnapshot::name(size_t i) const {
+    if (i < names.size()) {
+        return names[i];
+    }
+    auto it = std::lower_bound(named.begin(), named.end(), i,
+                               [](const std::pair<uint32_t, NPC_ptr> &entry, size_t index) {return entry.first < index;});
+    return it != named.end() && it->first == i ? std::string_view(it->second->name) : std::string_view();
+}
+
+void write_snapshot(std::ostream &os, const WorldSnapshot &snapshot) {
+    os.write(MAGIC, sizeof(MAGIC));
+    put(os, snapshot.tick);
+    put(os, snapshot.max_x);
+    put(os, snapshot.max_y);
+    put_string(os, snapshot.move_rng);
+    put(os, snapshot.dice_seed);
+
+    put(os, static_cast<uint32_t>(snapshot.kind_table.size()));
+    for (size_t k = 0; k < snapshot.kind_table.size(); ++k) {
+        const KindInfo &info = snapshot.kind_table[k];
+        put_string(os, info.name);
+        put(os, info.glyph);
+        put(os, static_cast<int32_t>(info.step));
+        put(os, static_cast<int32_t>(info.kill_radius));
+        put(os, snapshot.kind_prey[k]);
+    }
+
+    put(os, static_cast<uint32_t>(snapshot.size()));
+    put_array(os, snapshot.kinds);
+    put_array(os, snapshot.alive);
+    put_array(os, snapshot.xs);
+    put_array(os, snapshot.ys);
+    put_array(os, snapshot.serials);
+    // Имена NPC строятся здесь, на потоке писателя, а не в capture()
+    for (size_t i = 0; i < snapshot.size(); ++i) {
+        std::string_view name = snapshot.name(i);
+        put(os, static_cast<uint32_t>(name.size()));
+        os.write(name.data(), static_cast<std::streamsize>(name.size()));
+    }
+    put(os, static_cast<uint32_t>(snapshot.wake_order.size()));
+    put_array(os, snapshot.wake_order);
+    put_array(os, snapshot.wake_delay);
+    put(os, static_cast<uint32_t>(snapshot.fights.size()));
+    put_array(os, snapshot.fights);
+}
+
+bool read_snapshot(std::istream &is, WorldSnapshot &snapshot) {
+    char magic[sizeof(MAGIC)];
+    if (!is.read(magic, sizeof(magic)) || std::memcmp(magic, MAGIC, sizeof(MAGIC)) != 0) {
+        std::cerr << "Not a checkpoint file\n";
+        return false;
+    }
+
+    snapshot.clear();
+    uint32_t kind_count = 0;
+    bool ok = get(is, snapshot.tick) && get(is, snapshot.max_x) && get(is, snapshot.max_y)
+        && get_string(is, snapshot.move_rng) && get(is, snapshot.dice_seed)
+        && get(is, kind_count) && kind_count <= KindRegistry::MAX_KINDS;
+    snapshot.kind_table.resize(ok ? kind_count : 0);
+    snapshot.kind_prey.resize(ok ? kind_count : 0);
+    for (uint32_t k = 0; ok && k < kind_count; ++k) {
+        KindInfo &info = snapshot.kind_table[k];
+        int32_t step = 0;
+        int32_t radius = 0;
+        ok = get_string(is, info.name) && get(is, info.glyph) && get(is, step) && get(is, radius)
+            && get(is, snapshot.kind_prey[k]);
+        info.step = step;
+        info.kill_radius = radius;
+    }
+
+    uint32_t count = 0;
+    ok = ok && get(is, count)
+        && get_array(is, snapshot.kinds, count) && get_array(is, snapshot.alive, count)
+        && get_array(is, snapshot.xs, count) && get_array(is, snapshot.ys, count)
+        && get_array(is, snapshot.serials, count);
+
+    snapshot.names.resize(ok ? count : 0);
+    for (uint32_t i = 0; ok && i < count; ++i) {
+        ok = get_string(is, snapshot.names[i]);
+    }
+
+    uint32_t woken = 0;
+    ok = ok && get(is, woken) && woken <= count && get_array(is, snapshot.wake_order, woken)
+        && get_array(is, snapshot.wake_delay, woken);
+    for (size_t i = 0; ok && i < snapshot.wake_order.size(); ++i) {
+        ok = snapshot.wake_order[i] < count;
+    }
+    uint32_t fights = 0;
+    ok = ok && get(is, fights) && get_array(is, snapshot.fights, fights);
+    for (size_t i = 0; ok && i < snapshot.fights.size(); ++i) {
+        ok = snapshot.fights[i].attacker < count && snapshot.fights[i].defender < count;
+    }
+    for (size_t i = 0; ok && i < snapshot.kinds.size(); ++i) {
+        ok = snapshot.kinds[i] > 0 && snapshot.kinds[i] < kind_count;
+    }
+    if (!ok) {
+        std::cerr << "Truncated or corrupted checkpoint\n";
+    }
+    return ok;
+}
+
+Checkpointer::Checkpointer(std::string path_) : path(std::move(path_)) {
+    worker = std::thread(&Checkpointer::run, this);
+}
+
+Checkpointer::~Checkpointer() {
+    {
+        std::lock_guard<std::mutex> l(mtx);
+        stopping = true;
+    }
+    cv.notify_all();
+    worker.join();
+}
+
+bool Checkpointer::submit(WorldSnapshot &snapshot, double capture_ms) {
+    {
+        std::lock_guard<std::mutex> l(mtx);
+        if (pending) {
+            ++counters.skipped;
+            return false;
+        }
+        std::swap(buffer, snapshot);
+        pending = true;
+        counters.capture_ms_total += capture_ms;
+        counters.capture_ms_max = std::max(counters.capture_ms_max, capture_ms);
+    }
+    cv.notify_all();
+    return true;
+}
+
+void Checkpointer::flush() {
+    std::unique_lock<std::mutex> l(mtx);
+    cv.wait(l, [this]() { return !pending; });
+}
+
+Checkpointer::Stats Checkpointer::stats() const {
+    std::lock_guard<std::mutex> l(mtx);
+    return counters;
+}
+
+void Checkpointer::run() {
+    std::unique_lock<std::mutex> l(mtx);
+    while (true) {
+        cv.wait(l, [this]() { return pending || stopping; });
+        if (!pending) {
+            return;
+        }
+        l.unlock();
+
+        // Пишем во временный файл и переименовываем, чтобы на диске всегда был целый снимок
+        auto start = std::chrono::steady_clock::now();
+        std::string tmp = path + ".tmp";
+        size_t bytes = 0;
+        bool ok;
+        {
+            std::ofstream out(tmp, std::ios::binary | std::ios::trunc);
+            write_snapshot(out, buffer);
+            bytes = static_cast<size_t>(out.tellp());
+            ok = static_cast<bool>(out);
+        }
+        ok = ok && std::rename(tmp.c_str(), path.c_str()) == 0;
+        if (!ok) {
+            std::cerr << "Failed to write checkpoint " << path << "\n";
+        }
+        double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+        l.lock();
+        if (ok) {
+            ++counters.written;
+            counters.bytes += bytes;
+        }
+        counters.write_ms_total += ms;
+        counters.write_ms_max = std::max(counters.write_ms_max, ms);
+        pending = false;
+        cv.notify_all();
+    }
+}
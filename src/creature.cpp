@@ -0,0 +1,24 @@
+#include "creature.h"
+#include "factory.h"
+#include "kind_registry.h"
+
+Creature::Creature(int kind_, const std::string &name_, int x_, int y_) : NPC(static_cast<NpcKind>(kind_), name_, x_, y_) {}
+
+bool Creature::accept(const NPC_ptr &attacker) {
+    return attacker->visit_creature(std::static_pointer_cast<Creature>(shared_from_this()));
+}
+
+bool Creature::visit_dragon(const std::shared_ptr<Dragon> &){return KindRegistry::instance().can_kill(kind_tag, DragonType);}
+bool Creature::visit_bull(const std::shared_ptr<Bull> &){return KindRegistry::instance().can_kill(kind_tag, BullType);}
+bool Creature::visit_toad(const std::shared_ptr<Toad> &){return KindRegistry::instance().can_kill(kind_tag, ToadType);}
+bool Creature::visit_creature(const std::shared_ptr<Creature> &defender){return KindRegistry::instance().can_kill(kind_tag, defender->kind());}
+
+int Creature::step() const {return KindRegistry::instance().step(kind_tag);}
+int Creature::kill_radius() const {return KindRegistry::instance().kill_radius(kind_tag);}
+
+void Creature::describe(TextBuffer &out) const {describe_as(out, KindRegistry::instance().info(kind_tag).name);}
+
+void Creature::save(std::ostream &os) const {
+    os << kind_tag << std::endl;
+    NPC::save(os);
+}
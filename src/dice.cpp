@@ -0,0 +1,46 @@
+#include "dice.h"
+
+namespace {
+    uint64_t mix64(uint64_t x) {
+        x ^= x >> 33;
+        x *= 0xff51afd7ed558ccdull;
+        x ^= x >> 33;
+        x *= 0xc4ceb9fe1a85ec53ull;
+        x ^= x >> 33;
+        return x;
+    }
+
+    inline uint32_t mix32(uint32_t h) {
+        h ^= h >> 16;
+        h *= 0x85ebca6bu;
+        h ^= h >> 13;
+        h *= 0xc2b2ae35u;
+        h ^= h >> 16;
+        return h;
+    }
+
+    inline uint8_t face(uint32_t bits16) {
+        return static_cast<uint8_t>(((bits16 * 6u) >> 16) + 1);
+    }
+}
+
+uint32_t CounterDice::tick_key(uint64_t tick) const {
+    return static_cast<uint32_t>(mix64(seed ^ mix64(tick + 0x9e3779b97f4a7c15ull)));
+}
+
+void CounterDice::roll(uint64_t tick, uint32_t first, std::span<uint8_t> attack, std::span<uint8_t> defense) const {
+    const uint32_t key = tick_key(tick);
+    const size_t n = attack.size() < defense.size() ? attack.size() : defense.size();
+    uint8_t *__restrict a = attack.data();
+    uint8_t *__restrict d = defense.data();
+    for (size_t i = 0; i < n; ++i) {
+        uint32_t h = mix32((first + static_cast<uint32_t>(i)) * 0x9e3779b1u ^ key);
+        a[i] = face(h & 0xffffu);
+        d[i] = face(h >> 16);
+    }
+}
+
+std::pair<int, int> CounterDice::roll(uint64_t tick, uint32_t index) const {
+    uint32_t h = mix32(index * 0x9e3779b1u ^ tick_key(tick));
+    return {face(h & 0xffffu), face(h >> 16)};
+}
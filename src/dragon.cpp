@@ -1,9 +1,13 @@
 #include "dragon.h"
 #include "factory.h"
+#include "creature.h"
+#include "kind_registry.h"
 
-Dragon::Dragon(const std::string &name_, int x_, int y_) : NPC(name_, x_, y_) {}
+Dragon::Dragon() : NPC(DragonType) {}
 
-Dragon::Dragon(std::istream &is){
+Dragon::Dragon(const std::string &name_, int x_, int y_) : NPC(DragonType, name_, x_, y_) {}
+
+Dragon::Dragon(std::istream &is) : NPC(DragonType) {
     is >> name;
     is >> x >> y;
 }
@@ -12,11 +16,15 @@ bool Dragon::accept(const NPC_ptr &attacker) {
     return attacker->visit_dragon(std::static_pointer_cast<Dragon>(shared_from_this()));
 }
 
-bool Dragon::visit_dragon(const std::shared_ptr<Dragon> &defender){return false; }
-bool Dragon::visit_bull(const std::shared_ptr<Bull> &defender){return true;}
-bool Dragon::visit_toad(const std::shared_ptr<Toad> &defender){return false;}
+bool Dragon::visit_dragon(const std::shared_ptr<Dragon> &){return KindRegistry::instance().can_kill(DragonType, DragonType);}
+bool Dragon::visit_bull(const std::shared_ptr<Bull> &){return KindRegistry::instance().can_kill(DragonType, BullType);}
+bool Dragon::visit_toad(const std::shared_ptr<Toad> &){return KindRegistry::instance().can_kill(DragonType, ToadType);}
+bool Dragon::visit_creature(const std::shared_ptr<Creature> &defender){return KindRegistry::instance().can_kill(DragonType, defender->kind());}
+
+int Dragon::step() const {return KindRegistry::instance().step(DragonType);}
+int Dragon::kill_radius() const {return KindRegistry::instance().kill_radius(DragonType);}
 
-void Dragon::print() const {std::cout << "Dargon: " << *this << std::endl; }
+void Dragon::describe(TextBuffer &out) const {describe_as(out, "Dargon");}
 
 void Dragon::save(std::ostream &os) const {
     os << DragonType << std::endl;
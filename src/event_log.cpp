@@ -0,0 +1,165 @@
+#include "event_log.h"
+#include <iostream>
+
+namespace {
+    uint64_t splitmix64(uint64_t x) {
+        x += 0x9e3779b97f4a7c15ull;
+        x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ull;
+        x = (x ^ (x >> 27)) * 0x94d049bb133111ebull;
+        return x ^ (x >> 31);
+    }
+}
+
+void render(const LogRecord &record, LogFormat format, TextBuffer &out) {
+    switch (record.type) {
+    case LogRecord::Kill:
+        record.first->write_name(out);
+        out << " killed ";
+        record.second->write_name(out);
+        if (record.attack) {
+            out << " (Attack: " << record.attack << " vs Defense: " << record.defense << ")";
+        }
+        out << '\n';
+        break;
+    case LogRecord::Murder:
+    case LogRecord::Battle:
+        if (format == LogFormat::Compact) {
+            out << (record.type == LogRecord::Murder ? "Murder --------\n" : "Battle --------\n");
+            record.first->write_name(out);
+            out << " vs ";
+            record.second->write_name(out);
+            out << '\n';
+        } else {
+            out << (record.type == LogRecord::Murder ? "\nMurder --------\n" : "\nBattle between: \n");
+            record.first->describe(out);
+            out << '\n';
+            record.second->describe(out);
+            out << '\n';
+        }
+        break;
+    case LogRecord::Summary:
+        out << "Tick " << record.tick << ": " << record.tally->kills << (record.tally->kills == 1 ? " kill" : " kills");
+        if (record.tally->kinds) {
+            const char *separator = " (";
+            for (size_t k = 1; k < record.tally->by_kind.size(); ++k) {
+                if (record.tally->by_kind[k]) {
+                    out << separator << record.tally->kinds->info(static_cast<int>(k)).name << ' ' << record.tally->by_kind[k];
+                    separator = ", ";
+                }
+            }
+            if (*separator == ',') {
+                out << ')';
+            }
+        }
+        out << '\n';
+        break;
+    default:
+        break;
+    }
+}
+
+bool parse_log_level(std::string_view name, LogLevel &level) {
+    constexpr std::pair<std::string_view, LogLevel> names[] = {
+        {"debug", LogLevel::Debug}, {"info", LogLevel::Info}, {"warning", LogLevel::Warning}, {"off", LogLevel::Off},
+    };
+    for (auto &[n, l] : names) {
+        if (n == name) {
+            level = l;
+            return true;
+        }
+    }
+    return false;
+}
+
+void LogSink::set_sampling(uint32_t one_in, uint64_t seed) {
+    sample_one_in.store(one_in ? one_in : 1, std::memory_order_relaxed);
+    sample_seed.store(seed, std::memory_order_relaxed);
+    sample_counter.store(0, std::memory_order_relaxed);
+}
+
+// Решение по счётчику записей через хеш: без общего генератора и блокировок,
+// воспроизводимо при однопоточной подаче записей
+bool LogSink::sampled(const LogRecord &record) {
+    uint32_t one_in = sample_one_in.load(std::memory_order_relaxed);
+    if (one_in <= 1 || record.type == LogRecord::Summary) {
+        return true;
+    }
+    uint64_t n = sample_counter.fetch_add(1, std::memory_order_relaxed);
+    return splitmix64(n ^ sample_seed.load(std::memory_order_relaxed) * 0xd6e8feb86659fd93ull) % one_in == 0;
+}
+
+bool LogSink::within_rate(uint64_t &dropped) {
+    dropped = 0;
+    uint32_t limit = rate_limit.load(std::memory_order_relaxed);
+    if (limit == 0) {
+        return true;
+    }
+    std::lock_guard<std::mutex> lock(rate_mtx);
+    Clock::time_point now = Clock::now();
+    if (now - window_start >= std::chrono::seconds(1)) {
+        window_start = now;
+        window_count = 0;
+    }
+    if (window_count >= limit) {
+        ++unreported;
+        return false;
+    }
+    ++window_count;
+    std::swap(dropped, unreported);
+    return true;
+}
+
+LogSink::Stats LogSink::stats() const {
+    return {written.load(std::memory_order_relaxed), filtered.load(std::memory_order_relaxed),
+            sampled_out.load(std::memory_order_relaxed), rate_limited.load(std::memory_order_relaxed)};
+}
+
+void LogSink::submit(const LogRecord &record) {
+    if (!accepts(record)) {
+        filtered.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    if (!sampled(record)) {
+        sampled_out.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    uint64_t dropped = 0;
+    if (!within_rate(dropped)) {
+        rate_limited.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    TextBuffer &out = TextBuffer::local();
+    out.clear();
+    if (dropped) {
+        out << "... " << dropped << (dropped == 1 ? " message" : " messages") << " dropped by rate limit\n";
+    }
+    render(record, format, out);
+    write_text(out.view());
+    written.fetch_add(1, std::memory_order_relaxed);
+}
+
+void StreamSink::write_text(std::string_view text) {
+    std::lock_guard<std::mutex> lock(mtx);
+    os.write(text.data(), static_cast<std::streamsize>(text.size()));
+    if (flush) {
+        os.flush();
+    }
+}
+
+FileSink::FileSink(const std::string &path, LogFormat format_) : LogSink(format_) {
+    file.open(path, std::ios::app);
+}
+
+void FileSink::write_text(std::string_view text) {
+    if (!file.is_open()) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(mtx);
+    file.write(text.data(), static_cast<std::streamsize>(text.size()));
+    file.flush();
+}
+
+LogSink &console_log() {
+    static StreamSink sink(std::cout, LogFormat::Detailed);
+    return sink;
+}
@@ -2,24 +2,46 @@
 #include "dragon.h"
 #include "bull.h"
 #include "toad.h"
+#include "creature.h"
+#include "kind_registry.h"
 #include "observer.h"
 
-std::shared_ptr<NPC> factory(NpcKind type, const std::string &name, int x, int y) {
-    std::shared_ptr<NPC> result;
+namespace {
+    // Alloc<T> - распределитель для std::allocate_shared; std::allocator даёт то же, что make_shared
+    template <template <class> class Alloc, class... Args>
+    std::shared_ptr<NPC> create_with(NpcKind type, const std::string &name, int x, int y, Args &...args) {
+        std::shared_ptr<NPC> result;
 
-    switch (type){
-        case DragonType:
-            result = std::make_shared<Dragon>(name, x, y);
-            break;
-        case BullType:
-            result = std::make_shared<Bull>(name, x, y);
-            break;
-        case ToadType:
-            result = std::make_shared<Toad>(name, x, y);
-            break;
-        default:
-            break;
+        switch (type){
+            case DragonType:
+                result = std::allocate_shared<Dragon>(Alloc<Dragon>(args...), name, x, y);
+                break;
+            case BullType:
+                result = std::allocate_shared<Bull>(Alloc<Bull>(args...), name, x, y);
+                break;
+            case ToadType:
+                result = std::allocate_shared<Toad>(Alloc<Toad>(args...), name, x, y);
+                break;
+            default:
+                if (KindRegistry::instance().known(type)) {
+                    result = std::allocate_shared<Creature>(Alloc<Creature>(args...), type, name, x, y);
+                }
+                break;
+        }
+        return result;
     }
+}
+
+std::shared_ptr<NPC> create(NpcKind type, const std::string &name, int x, int y) {
+    return create_with<std::allocator>(type, name, x, y);
+}
+
+std::shared_ptr<NPC> create(NpcArena &arena, NpcKind type, const std::string &name, int x, int y) {
+    return create_with<ArenaAllocator>(type, name, x, y, arena);
+}
+
+std::shared_ptr<NPC> factory(NpcKind type, const std::string &name, int x, int y) {
+    std::shared_ptr<NPC> result = create(type, name, x, y);
 
     if (result) {
         result->subscribe(TextObserver::get());
@@ -52,8 +74,12 @@ std::shared_ptr<NPC> factory(std::istream &is) {
                 result = std::make_shared<Toad>(name, x, y);
                 break;
             default:
-                std::cerr << "Unknown NPC type: " << type << "\n";
-                return nullptr;
+                if (!KindRegistry::instance().known(type)) {
+                    std::cerr << "Unknown NPC type: " << type << "\n";
+                    return nullptr;
+                }
+                result = std::make_shared<Creature>(type, name, x, y);
+                break;
         }
     }
 
@@ -62,4 +88,4 @@ std::shared_ptr<NPC> factory(std::istream &is) {
         result->subscribe(FileObserver::get());
     }
     return result;
-}
\ No newline at end of file
+}
@@ -0,0 +1,229 @@
+#include "flow_field.h"
+#include <algorithm>
+
+namespace {
+    int field_for(std::vector<uint64_t> &masks, uint64_t mask) {
+        auto it = std::find(masks.begin(), masks.end(), mask);
+        if (it == masks.end()) {
+            masks.push_back(mask);
+            return static_cast<int>(masks.size() - 1);
+        }
+        return static_cast<int>(it - masks.begin());
+    }
+}
+
+void FlowField::rebuild(const World &world, int width, int height, int cell_size, unsigned threads) {
+    size_t kinds = registry.size();
+    if (cell_size <= 0) {
+        int smallest = 0;
+        for (size_t k = 1; k < kinds; ++k) {
+            int r = registry.kill_radius(static_cast<int>(k));
+            if (r > 0 && (smallest == 0 || r < smallest)) {
+                smallest = r;
+            }
+        }
+        cell_size = std::max(1, smallest / 2);
+    }
+    cell = cell_size;
+    cols = std::max(1, (width + cell - 1) / cell);
+    rows = std::max(1, (height + cell - 1) / cell);
+
+    // Какие виды живут в каждой клетке - один проход по миру
+    std::vector<uint64_t> occupied(static_cast<size_t>(cols) * rows, 0);
+    uint64_t present = 0;
+    std::span<const PackedNpc> hot = world.hot_view();
+    for (size_t i = 0; i < hot.size(); ++i) {
+        if (world.alive_at(i)) {
+            uint64_t bit = uint64_t{1} << hot[i].kind;
+            occupied[cell_index(hot[i].x, hot[i].y)] |= bit;
+            present |= bit;
+        }
+    }
+
+    masks.clear();
+    chase_field.assign(kinds, -1);
+    flee_field.assign(kinds, -1);
+    flee_cells.assign(kinds, 0);
+    for (size_t k = 1; k < kinds; ++k) {
+        if (!(present >> k & 1)) {
+            continue;
+        }
+        uint64_t prey = registry.prey_mask(static_cast<int>(k)) & present;
+        if (prey) {
+            chase_field[k] = field_for(masks, prey);
+        }
+        uint64_t threats = 0;
+        int reach = 0;
+        for (size_t a = 1; a < kinds; ++a) {
+            if ((present >> a & 1) && registry.can_kill(static_cast<int>(a), static_cast<int>(k))) {
+                threats |= uint64_t{1} << a;
+                reach = std::max(reach, registry.kill_radius(static_cast<int>(a)) + registry.step(static_cast<int>(a)));
+            }
+        }
+        if (threats) {
+            flee_field[k] = field_for(masks, threats);
+            flee_cells[k] = static_cast<uint16_t>(std::min(reach / cell + 1, UNREACHED - 1));
+        }
+    }
+
+    distances.resize(masks.size());
+    if (threads == 0) {
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    // Поля независимы: каждый поток считает свою часть, первую часть - вызывающий поток
+    unsigned workers = std::min<unsigned>(threads, static_cast<unsigned>(masks.size()));
+    run_parallel(workers, [&](unsigned t) {
+        for (size_t f = t; f < masks.size(); f += workers) {
+            fill(f, occupied);
+        }
+    });
+}
+
+FlowField::~FlowField() {
+    {
+        std::lock_guard<std::mutex> l(pool_mtx);
+        stopping = true;
+    }
+    pool_cv.notify_all();
+    for (auto &w : pool) {
+        w.join();
+    }
+}
+
+void FlowField::run_parallel(unsigned workers, const std::function<void(unsigned)> &task) {
+    if (workers <= 1) {
+        if (workers == 1) {
+            task(0);
+        }
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> l(pool_mtx);
+        while (pool.size() + 1 < workers) {
+            pool.emplace_back(&FlowField::worker_loop, this, static_cast<unsigned>(pool.size() + 1), job_round);
+        }
+        job = &task;
+        job_workers = workers;
+        job_pending = workers - 1;
+        ++job_round;
+    }
+    pool_cv.notify_all();
+    task(0);
+    std::unique_lock<std::mutex> l(pool_mtx);
+    done_cv.wait(l, [this]() { return job_pending == 0; });
+    job = nullptr;
+}
+
+void FlowField::worker_loop(unsigned t, uint64_t seen) {
+    std::unique_lock<std::mutex> l(pool_mtx);
+    while (true) {
+        pool_cv.wait(l, [&]() { return stopping || job_round != seen; });
+        if (stopping) {
+            return;
+        }
+        seen = job_round;
+        if (t >= job_workers) {
+            continue;
+        }
+        const std::function<void(unsigned)> &task = *job;
+        l.unlock();
+        task(t);
+        l.lock();
+        if (--job_pending == 0) {
+            done_cv.notify_one();
+        }
+    }
+}
+
+size_t FlowField::cell_index(int x, int y) const {
+    int cx = std::clamp(x / cell, 0, cols - 1);
+    int cy = std::clamp(y / cell, 0, rows - 1);
+    return static_cast<size_t>(cy) * cols + cx;
+}
+
+// Расстояния BFS по 4 соседям от всех источников сразу. Для манхэттенской метрики BFS совпадает
+// с двумя проходами по растру (сверху-слева и снизу-справа), которые не требуют очереди
+// и читают память подряд - так и считаем.
+void FlowField::fill(size_t field, const std::vector<uint64_t> &occupied) {
+    std::vector<uint16_t> &dist = distances[field];
+    dist.resize(occupied.size());
+    uint64_t mask = masks[field];
+    auto relax = [](uint16_t &d, uint16_t a, uint16_t b) {
+        uint16_t n = std::min(a, b);
+        if (n != UNREACHED && n + 1 < d) {
+            d = static_cast<uint16_t>(std::min(n + 1, UNREACHED - 1));
+        }
+    };
+    for (int y = 0; y < rows; ++y) {
+        uint16_t *row = dist.data() + static_cast<size_t>(y) * cols;
+        const uint16_t *up = y > 0 ? row - cols : nullptr;
+        const uint64_t *occ = occupied.data() + static_cast<size_t>(y) * cols;
+        for (int x = 0; x < cols; ++x) {
+            row[x] = (occ[x] & mask) ? 0 : UNREACHED;
+            relax(row[x], x > 0 ? row[x - 1] : UNREACHED, up ? up[x] : UNREACHED);
+        }
+    }
+    for (int y = rows - 1; y >= 0; --y) {
+        uint16_t *row = dist.data() + static_cast<size_t>(y) * cols;
+        const uint16_t *down = y + 1 < rows ? row + cols : nullptr;
+        for (int x = cols - 1; x >= 0; --x) {
+            relax(row[x], x + 1 < cols ? row[x + 1] : UNREACHED, down ? down[x] : UNREACHED);
+        }
+    }
+}
+
+// Направление по каждой оси выбирается отдельно, сравнением соседей слева/справа и сверху/снизу:
+// в манхэттенском поле так получается и диагональный шаг. Если обе стороны оси одинаково хороши
+// (цель на этой же линии), по оси не двигаемся - иначе выбор перекашивался бы в одну сторону.
+std::pair<int, int> FlowField::best_neighbour(size_t field, size_t from, bool toward) const {
+    const std::vector<uint16_t> &dist = distances[field];
+    int cx = static_cast<int>(from % cols), cy = static_cast<int>(from / cols);
+    int here = dist[from];
+    // Клетка за краем поля не лучше текущей
+    auto at = [&](int nx, int ny) {
+        if (nx < 0 || ny < 0 || nx >= cols || ny >= rows) {
+            return here;
+        }
+        return static_cast<int>(dist[static_cast<size_t>(ny) * cols + nx]);
+    };
+    auto axis = [&](int minus, int plus) {
+        int gain_minus = toward ? here - minus : minus - here;
+        int gain_plus = toward ? here - plus : plus - here;
+        if (gain_minus > 0 && gain_minus > gain_plus) {
+            return -1;
+        }
+        if (gain_plus > 0 && gain_plus > gain_minus) {
+            return 1;
+        }
+        return 0;
+    };
+    return {axis(at(cx - 1, cy), at(cx + 1, cy)), axis(at(cx, cy - 1), at(cx, cy + 1))};
+}
+
+std::pair<int, int> FlowField::direction(int x, int y, int kind) const {
+    if (distances.empty() || kind <= 0 || static_cast<size_t>(kind) >= chase_field.size()) {
+        return {0, 0};
+    }
+    size_t c = cell_index(x, y);
+    if (flee_field[kind] >= 0 && distances[flee_field[kind]][c] <= flee_cells[kind]) {
+        return best_neighbour(flee_field[kind], c, false);
+    }
+    if (chase_field[kind] >= 0) {
+        return best_neighbour(chase_field[kind], c, true);
+    }
+    return {0, 0};
+}
+
+uint16_t FlowField::prey_distance(int x, int y, int kind) const {
+    if (static_cast<size_t>(kind) >= chase_field.size() || chase_field[kind] < 0) {
+        return UNREACHED;
+    }
+    return distances[chase_field[kind]][cell_index(x, y)];
+}
+
+uint16_t FlowField::threat_distance(int x, int y, int kind) const {
+    if (static_cast<size_t>(kind) >= flee_field.size() || flee_field[kind] < 0) {
+        return UNREACHED;
+    }
+    return distances[flee_field[kind]][cell_index(x, y)];
+}
@@ -0,0 +1,180 @@
+#include "frame_ring.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+FrameSegment::~FrameSegment() {
+    unmap();
+}
+
+void store_record(FrameRecord &to, const FrameRecord &from) {
+    store_field(to.x, from.x);
+    store_field(to.y, from.y);
+    store_field(to.id, from.id);
+    store_field(to.kind, from.kind);
+    store_field(to.alive, from.alive);
+    store_field(to.reserved, from.reserved);
+}
+
+FrameRecord load_record(const FrameRecord &from) {
+    return FrameRecord{load_field(from.x), load_field(from.y), load_field(from.id),
+                       load_field(from.kind), load_field(from.alive), load_field(from.reserved)};
+}
+
+FrameSlotHeader &FrameSegment::slot(uint64_t frame) const {
+    const FrameRingHeader &h = header();
+    char *at = static_cast<char *>(base) + h.slots_offset + (frame % h.slot_count) * h.slot_bytes;
+    return *reinterpret_cast<FrameSlotHeader *>(at);
+}
+
+// Старый сегмент с тем же именем (от упавшего процесса) удаляется: читатели, которые
+// ещё держат его, дочитают старое отображение, новые откроют новый сегмент
+bool FrameSegment::create(const std::string &name, size_t bytes_) {
+    unmap();
+    shm_unlink(name.c_str());
+    int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644);
+    if (fd < 0) {
+        std::cerr << "Cannot create shared memory " << name << ": " << std::strerror(errno) << "\n";
+        return false;
+    }
+    void *at = MAP_FAILED;
+    if (ftruncate(fd, static_cast<off_t>(bytes_)) == 0) {
+        at = mmap(nullptr, bytes_, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    }
+    int error = errno;
+    close(fd);
+    if (at == MAP_FAILED) {
+        std::cerr << "Cannot map shared memory " << name << ": " << std::strerror(error) << "\n";
+        shm_unlink(name.c_str());
+        return false;
+    }
+    base = at;
+    bytes = bytes_;
+    segment_name = name;
+    owner = true;
+    return true;
+}
+
+bool FrameSegment::attach(const std::string &name) {
+    unmap();
+    int fd = shm_open(name.c_str(), O_RDONLY, 0);
+    if (fd < 0) {
+        std::cerr << "Cannot open shared memory " << name << ": " << std::strerror(errno) << "\n";
+        return false;
+    }
+    struct stat st{};
+    void *at = MAP_FAILED;
+    if (fstat(fd, &st) == 0 && static_cast<size_t>(st.st_size) >= sizeof(FrameRingHeader)) {
+        at = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_SHARED, fd, 0);
+    }
+    close(fd);
+    if (at == MAP_FAILED) {
+        std::cerr << "Cannot map shared memory " << name << "\n";
+        return false;
+    }
+    base = at;
+    bytes = static_cast<size_t>(st.st_size);
+    segment_name = name;
+    owner = false;
+    return true;
+}
+
+void FrameSegment::unmap() {
+    if (!base) {
+        return;
+    }
+    munmap(base, bytes);
+    if (owner) {
+        shm_unlink(segment_name.c_str());
+    }
+    base = nullptr;
+    bytes = 0;
+    owner = false;
+}
+
+bool FrameReader::open(const std::string &name) {
+    cursor = 0;
+    lost_frames = 0;
+    if (!attach(name)) {
+        return false;
+    }
+    const FrameRingHeader &h = header();
+    bool valid = h.magic.load(std::memory_order_acquire) == FRAME_RING_MAGIC_WORD
+        && h.record_bytes == sizeof(FrameRecord) && h.slot_count > 0
+        && h.slots_offset >= sizeof(FrameRingHeader)
+        && h.slot_bytes >= sizeof(FrameSlotHeader) + static_cast<uint64_t>(h.capacity) * sizeof(FrameRecord)
+        && h.slots_offset + h.slot_count * h.slot_bytes <= bytes;
+    if (!valid) {
+        std::cerr << "Shared memory " << name << " is not a frame ring (or not initialised yet)\n";
+        unmap();
+        return false;
+    }
+    uint64_t head = published();
+    cursor = head > h.slot_count ? head - h.slot_count : 0;
+    return true;
+}
+
+bool FrameReader::copy(uint64_t number, Frame &frame) {
+    FrameSlotHeader &s = slot(number);
+    const uint64_t ready = 2 * number + 2;
+    if (s.sequence.load(std::memory_order_acquire) != ready) {
+        return false;
+    }
+    // Поля кадра могут меняться прямо сейчас - всё читается в копию и проверяется повторным sequence
+    uint32_t count = std::min(load_field(s.count), header().capacity);
+    frame.tick = load_field(s.tick);
+    frame.truncated = load_field(s.truncated) != 0;
+    frame.records.resize(count);
+    const FrameRecord *from = records(s);
+    for (uint32_t i = 0; i < count; ++i) {
+        frame.records[i] = load_record(from[i]);
+    }
+    if (s.sequence.load(std::memory_order_relaxed) != ready) {
+        return false;
+    }
+    frame.number = number;
+    return true;
+}
+
+bool FrameReader::next(Frame &frame) {
+    if (!mapped()) {
+        return false;
+    }
+    for (;;) {
+        uint64_t head = published();
+        if (cursor >= head) {
+            return false;
+        }
+        uint64_t oldest = head > header().slot_count ? head - header().slot_count : 0;
+        if (cursor < oldest) {
+            lost_frames += oldest - cursor;
+            cursor = oldest;
+        }
+        // Записанный кадр не прочитался, только если его уже перезаписали
+        if (copy(cursor++, frame)) {
+            return true;
+        }
+        ++lost_frames;
+    }
+}
+
+bool FrameReader::latest(Frame &frame) {
+    if (!mapped()) {
+        return false;
+    }
+    for (;;) {
+        uint64_t head = published();
+        if (head == 0 || head <= cursor) {
+            return false;
+        }
+        if (copy(head - 1, frame)) {
+            cursor = head;
+            return true;
+        }
+    }
+}
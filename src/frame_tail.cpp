@@ -0,0 +1,55 @@
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "frame_ring.h"
+
+using namespace std::chrono_literals;
+
+// Пример читателя кольца кадров: раз в секунду печатает последний тик и живых по видам.
+// ./frame_tail [NAME] - имя сегмента, по умолчанию /npc_world (как у ./main --export)
+int main(int argc, char **argv) {
+    std::string name = argc > 1 ? argv[1] : "/npc_world";
+    FrameReader reader;
+    if (!reader.open(name)) {
+        return 1;
+    }
+    const FrameRingHeader &header = reader.header();
+    std::cout << "Ring " << name << ": map " << header.width << "x" << header.height << ", "
+              << header.slot_count << " frames of up to " << header.capacity << " NPCs" << std::endl;
+
+    Frame frame;
+    uint64_t frames = 0;
+    auto last_print = std::chrono::steady_clock::now();
+    auto last_frame = last_print;
+    // Писатель молчит дольше двух секунд - игра закончилась
+    while (std::chrono::steady_clock::now() - last_frame < 2s) {
+        bool got = false;
+        while (reader.next(frame)) {
+            ++frames;
+            got = true;
+        }
+        auto now = std::chrono::steady_clock::now();
+        if (got) {
+            last_frame = now;
+        }
+        if (got && now - last_print >= 1s) {
+            last_print = now;
+            std::vector<uint32_t> alive(header.kind_count, 0);
+            for (const FrameRecord &r : frame.records) {
+                if (r.alive && r.kind < alive.size()) {
+                    ++alive[r.kind];
+                }
+            }
+            std::cout << "tick " << frame.tick << ": frames " << frames << ", lost " << reader.lost() << ", alive";
+            for (uint32_t k = 1; k < header.kind_count; ++k) {
+                std::cout << " " << header.kinds[k].glyph << ":" << alive[k];
+            }
+            std::cout << std::endl;
+        }
+        std::this_thread::sleep_for(5ms);
+    }
+    std::cout << "Read " << frames << " frames, lost " << reader.lost() << std::endl;
+    return 0;
+}
@@ -0,0 +1,64 @@
+#include "frame_writer.h"
+#include <algorithm>
+#include <cstring>
+#include <new>
+#include <unistd.h>
+
+bool FrameWriter::open(const std::string &name, uint32_t capacity, int width, int height,
+                       const KindRegistry &registry, uint32_t slots) {
+    frames = 0;
+    slots = std::max(1u, slots);
+    // Слоты выровнены по 64 байта, чтобы заголовок слота не делил кэш-линию с соседним
+    auto align = [](uint64_t n) {return (n + 63) / 64 * 64;};
+    uint64_t slots_offset = align(sizeof(FrameRingHeader));
+    uint64_t slot_bytes = align(sizeof(FrameSlotHeader) + static_cast<uint64_t>(capacity) * sizeof(FrameRecord));
+    if (!create(name, slots_offset + slot_bytes * slots)) {
+        return false;
+    }
+
+    FrameRingHeader *h = new (base) FrameRingHeader{};
+    h->slot_count = slots;
+    h->capacity = capacity;
+    h->record_bytes = sizeof(FrameRecord);
+    h->kind_count = static_cast<uint32_t>(std::min(registry.size(), FRAME_RING_KINDS));
+    h->slots_offset = slots_offset;
+    h->slot_bytes = slot_bytes;
+    h->width = width;
+    h->height = height;
+    h->writer_pid = static_cast<uint64_t>(getpid());
+    for (uint32_t k = 1; k < h->kind_count; ++k) {
+        const KindInfo &info = registry.info(static_cast<int>(k));
+        std::strncpy(h->kinds[k].name, info.name.c_str(), sizeof(h->kinds[k].name) - 1);
+        h->kinds[k].glyph = info.glyph;
+    }
+    for (uint32_t s = 0; s < slots; ++s) {
+        new (static_cast<char *>(base) + slots_offset + s * slot_bytes) FrameSlotHeader{};
+    }
+    // Магия - последней, release-записью: читатель, открывший сегмент раньше, не примет его за готовый
+    h->magic.store(FRAME_RING_MAGIC_WORD, std::memory_order_release);
+    return true;
+}
+
+void FrameWriter::publish(const World &world, uint64_t tick) {
+    if (!mapped()) {
+        return;
+    }
+    FrameRingHeader &h = header();
+    FrameSlotHeader &s = slot(frames);
+    s.sequence.store(2 * frames + 1, std::memory_order_relaxed);
+
+    auto lock = world.read_lock();
+    size_t count = std::min<size_t>(world.size(), h.capacity);
+    FrameRecord *out = records(s);
+    std::span<const PackedNpc> hot = world.hot_view();
+    for (size_t i = 0; i < count; ++i) {
+        store_record(out[i], FrameRecord{hot[i].x, hot[i].y, world.id_at(i).index, hot[i].kind,
+                                         static_cast<uint8_t>(world.alive_at(i)), 0});
+    }
+    store_field(s.tick, tick);
+    store_field(s.count, static_cast<uint32_t>(count));
+    store_field(s.truncated, static_cast<uint32_t>(count < world.size()));
+
+    s.sequence.store(2 * frames + 2, std::memory_order_release);
+    h.published.store(++frames, std::memory_order_release);
+}
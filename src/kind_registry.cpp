@@ -0,0 +1,177 @@
+#include "kind_registry.h"
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include "dragon.h"
+#include "bull.h"
+#include "toad.h"
+
+KindRegistry::KindRegistry() : kills(MAX_KINDS * MAX_KINDS, 0) {
+    add(KindInfo{"", '?', 0, 0});
+    add(KindInfo{"Dragon", 'D', Dragon::STEP, Dragon::KILL_RADIUS});
+    add(KindInfo{"Bull", 'B', Bull::STEP, Bull::KILL_RADIUS});
+    add(KindInfo{"Toad", 'T', Toad::STEP, Toad::KILL_RADIUS});
+    // Правила варианта: дракон ест быков, бык топчет жаб, жаба никого не убивает
+    set_kill(1, 2, true);
+    set_kill(2, 3, true);
+}
+
+KindRegistry &KindRegistry::instance() {
+    static KindRegistry registry;
+    return registry;
+}
+
+int KindRegistry::add(const KindInfo &info) {
+    if (infos.size() >= MAX_KINDS) {
+        std::cerr << "Too many NPC kinds, limit is " << MAX_KINDS << "\n";
+        return 0;
+    }
+    infos.push_back(info);
+    steps.push_back(info.step);
+    radii.push_back(info.kill_radius);
+    reaches.push_back(reach_of(info.kill_radius));
+    glyphs.push_back(info.glyph);
+    predators.push_back(0);
+    prey_masks.push_back(0);
+    return static_cast<int>(infos.size() - 1);
+}
+
+int KindRegistry::find(std::string_view name) const {
+    for (size_t i = 1; i < infos.size(); ++i) {
+        if (infos[i].name == name) {
+            return static_cast<int>(i);
+        }
+    }
+    return 0;
+}
+
+void KindRegistry::set_params(int kind, int step_, int kill_radius_) {
+    infos[kind].step = steps[kind] = step_;
+    infos[kind].kill_radius = radii[kind] = kill_radius_;
+    reaches[kind] = reach_of(kill_radius_);
+}
+
+void KindRegistry::set_kill(int attacker, int defender, bool allowed) {
+    kills[attacker * MAX_KINDS + defender] = allowed;
+    uint64_t bit = uint64_t{1} << defender;
+    prey_masks[attacker] = allowed ? prey_masks[attacker] | bit : prey_masks[attacker] & ~bit;
+    predators[attacker] = prey_masks[attacker] != 0;
+}
+
+bool KindRegistry::load(std::istream &is) {
+    // Файл разбирается в копию: ошибка в середине файла не оставляет таблицу наполовину обновлённой
+    KindRegistry loaded(*this);
+    if (!loaded.parse(is)) {
+        return false;
+    }
+    *this = std::move(loaded);
+    return true;
+}
+
+bool KindRegistry::parse(std::istream &is) {
+    std::vector<std::pair<int, std::vector<std::string>>> rules;
+    std::string line;
+    int line_no = 0;
+
+    while (std::getline(is, line)) {
+        ++line_no;
+        line = line.substr(0, line.find('#'));
+        std::istringstream row(line);
+        KindInfo info;
+        if (!(row >> info.name)) {
+            continue;
+        }
+        if (!(row >> info.glyph >> info.step >> info.kill_radius) || info.step < 0 || info.kill_radius < 0) {
+            std::cerr << "Invalid kind entry at line " << line_no << "\n";
+            return false;
+        }
+
+        int kind = find(info.name);
+        if (kind) {
+            infos[kind].glyph = glyphs[kind] = info.glyph;
+            set_params(kind, info.step, info.kill_radius);
+        } else if (!(kind = add(info))) {
+            return false;
+        }
+
+        std::vector<std::string> victims;
+        for (std::string victim; row >> victim;) {
+            victims.push_back(victim);
+        }
+        rules.emplace_back(kind, std::move(victims));
+    }
+
+    // Жертвы разбираются после чтения всей таблицы, чтобы можно было ссылаться на виды ниже по файлу
+    for (auto &[kind, victims] : rules) {
+        for (int d = 0; d < MAX_KINDS; ++d) {
+            set_kill(kind, d, false);
+        }
+        for (auto &victim : victims) {
+            int defender = find(victim);
+            if (!defender) {
+                std::cerr << "Unknown kind in kill list: " << victim << "\n";
+                return false;
+            }
+            set_kill(kind, defender, true);
+        }
+    }
+    return true;
+}
+
+void KindRegistry::save_table(std::vector<KindInfo> &table, std::vector<uint64_t> &prey) const {
+    table = infos;
+    prey = prey_masks;
+}
+
+bool KindRegistry::load_table(const std::vector<KindInfo> &table, const std::vector<uint64_t> &prey) {
+    if (table.empty() || table.size() > MAX_KINDS || prey.size() != table.size()) {
+        std::cerr << "Invalid kinds table\n";
+        return false;
+    }
+    KindRegistry loaded;
+    loaded.reset();
+    for (auto &info : table) {
+        loaded.add(info);
+    }
+    for (size_t a = 0; a < table.size(); ++a) {
+        for (size_t d = 0; d < table.size(); ++d) {
+            loaded.set_kill(static_cast<int>(a), static_cast<int>(d), prey[a] >> d & 1);
+        }
+    }
+    *this = std::move(loaded);
+    return true;
+}
+
+bool KindRegistry::same_table(const std::vector<KindInfo> &table, const std::vector<uint64_t> &prey) const {
+    if (table.size() != infos.size() || prey != prey_masks) {
+        return false;
+    }
+    for (size_t k = 0; k < table.size(); ++k) {
+        const KindInfo &a = table[k];
+        const KindInfo &b = infos[k];
+        if (a.name != b.name || a.glyph != b.glyph || a.step != b.step || a.kill_radius != b.kill_radius) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void KindRegistry::reset() {
+    infos.clear();
+    steps.clear();
+    radii.clear();
+    reaches.clear();
+    glyphs.clear();
+    predators.clear();
+    prey_masks.clear();
+    std::fill(kills.begin(), kills.end(), 0);
+}
+
+bool KindRegistry::load_file(const std::string &path) {
+    std::ifstream in(path);
+    if (!in) {
+        std::cerr << "Cannot open kinds file " << path << "\n";
+        return false;
+    }
+    return load(in);
+}
@@ -0,0 +1,48 @@
+#include "locality.h"
+#include <algorithm>
+
+namespace {
+    // Раздвигает 32 бита так, что между ними встают нули: b31..b0 -> 0 b31 0 b30 ... 0 b0
+    uint64_t spread(uint32_t v) {
+        uint64_t x = v;
+        x = (x | (x << 16)) & 0x0000FFFF0000FFFFull;
+        x = (x | (x << 8)) & 0x00FF00FF00FF00FFull;
+        x = (x | (x << 4)) & 0x0F0F0F0F0F0F0F0Full;
+        x = (x | (x << 2)) & 0x3333333333333333ull;
+        x = (x | (x << 1)) & 0x5555555555555555ull;
+        return x;
+    }
+}
+
+uint64_t morton_key(int32_t x, int32_t y) {
+    // Сдвиг на 2^31 сохраняет порядок знаковых координат в беззнаковых
+    return spread(static_cast<uint32_t>(x) ^ 0x80000000u) | spread(static_cast<uint32_t>(y) ^ 0x80000000u) << 1;
+}
+
+double morton_disorder(const World &world) {
+    std::span<const PackedNpc> hot = world.hot_view();
+    if (hot.size() < 2) {
+        return 0.0;
+    }
+    size_t descents = 0;
+    uint64_t previous = morton_key(hot[0].x, hot[0].y);
+    for (size_t i = 1; i < hot.size(); ++i) {
+        uint64_t key = morton_key(hot[i].x, hot[i].y);
+        descents += key < previous;
+        previous = key;
+    }
+    return static_cast<double>(descents) / static_cast<double>(hot.size() - 1);
+}
+
+void morton_order(const World &world, std::vector<uint32_t> &order) {
+    std::span<const PackedNpc> hot = world.hot_view();
+    std::vector<std::pair<uint64_t, uint32_t>> keyed(hot.size());
+    for (size_t i = 0; i < hot.size(); ++i) {
+        keyed[i] = {morton_key(hot[i].x, hot[i].y), static_cast<uint32_t>(i)};
+    }
+    std::sort(keyed.begin(), keyed.end());
+    order.resize(keyed.size());
+    for (size_t i = 0; i < keyed.size(); ++i) {
+        order[i] = keyed[i].second;
+    }
+}
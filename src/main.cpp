@@ -1,228 +1,278 @@
 #include <thread>
 #include <chrono>
-#include <queue>
+#include <vector>
 #include <random>
-#include <set>
 #include <mutex>
 #include <iostream>
 #include <atomic>
+#include <algorithm>
+#include <fstream>
+#include <string>
+#include <memory>
 #include "npc.h"
-#include "factory.h"
-#include "dragon.h"
-#include "bull.h"
-#include "toad.h"
+#include "world.h"
+#include "simulation.h"
+#include "checkpoint.h"
+#include "renderer.h"
 #include "observer.h"
+#include "kind_registry.h"
+#include "replay.h"
+#include "world_gen.h"
+#include "frame_writer.h"
+#include "event_log.h"
 
 using namespace std::chrono_literals;
 
-constexpr int DRAGON_MOVE_DISTANCE = 50;
-constexpr int DRAGON_KILL_DISTANCE = 30;
-constexpr int BULL_MOVE_DISTANCE = 30;
-constexpr int BULL_KILL_DISTANCE = 10;
-constexpr int TOAD_MOVE_DISTANCE = 1;
-constexpr int TOAD_KILL_DISTANCE = 10;
-
-struct FightEvent {
-    std::shared_ptr<NPC> attacker;
-    std::shared_ptr<NPC> defender;
-};
-
-class FightManager {
-    std::queue<FightEvent> events;
-    std::mutex mtx;
-    std::mt19937 rng{std::random_device{}()};
-    std::uniform_int_distribution<int> d6{1, 6};
-    std::atomic_bool &running;
-    std::mutex cout_mutex;
-
-public:
-    explicit FightManager(std::atomic_bool &flag) : running(flag) {}
-
-    void add_event(FightEvent &&ev) {
-        std::lock_guard<std::mutex> l(mtx);
-        events.push(std::move(ev));
-    }
-
-    void operator()() {
-        while (running || !events.empty()) {
-            std::optional<FightEvent> ev;
-            {
-                std::lock_guard<std::mutex> l(mtx);
-                if (!events.empty()) {
-                    ev = events.front();
-                    events.pop();
-                }
-            }
-
-            if (ev) {
-                auto &att = ev->attacker;
-                auto &def = ev->defender;
-                if (att->is_alive() && def->is_alive()) {
-                    bool can_kill = def->accept(att);
-                    if (can_kill) {
-                        int attack = d6(rng);
-                        int defense = d6(rng);
-                        if (attack > defense) {
-                            {
-                                std::lock_guard<std::mutex> l(cout_mutex);
-                                std::cout << att->name << " killed " << def->name 
-                                          << " (Attack: " << attack 
-                                          << " vs Defense: " << defense << ")" << std::endl;
-                            }
-                            def->must_die();
-                            att->fight_notify(def, true);
-                        }
-                    }
-                }
-            }
-            std::this_thread::sleep_for(10ms);
-        }
-    }
-};
-
-int main() {
+int main(int argc, char **argv) {
     constexpr int MAX_X = 100;
     constexpr int MAX_Y = 100;
     constexpr int GRID = 20;
-    constexpr int STEP_X = MAX_X / GRID;
-    constexpr int STEP_Y = MAX_Y / GRID;
 
-    std::srand(static_cast<unsigned>(std::time(nullptr)));
+    std::string restore_path;
+    std::string checkpoint_path;
+    uint64_t checkpoint_every = 500;
+    int view_x = 0, view_y = 0, view_w = MAX_X, view_h = MAX_Y;
+    bool density = false;
+    std::string kinds_path;
+    bool flow = false;
+    std::string record_path;
+    std::string replay_path;
+    uint64_t replay_until = UINT64_MAX;
+    size_t npc_count = 50;
+    double tick_rate = 100.0;
+    std::string export_name;
+    LogLevel log_level = LogLevel::Debug;
+    LogLevel file_log_level = LogLevel::Debug;
+    uint32_t log_sample = 1;
+    uint32_t log_rate = 0;
+    bool log_summary = false;
+    for (int a = 1; a < argc; ++a) {
+        std::string arg = argv[a];
+        if (arg == "--restore" && a + 1 < argc) {
+            restore_path = argv[++a];
+        } else if (arg == "--checkpoint" && a + 1 < argc) {
+            checkpoint_path = argv[++a];
+        } else if (arg == "--checkpoint-every" && a + 1 < argc) {
+            checkpoint_every = std::max(1ull, std::stoull(argv[++a]));
+        } else if (arg == "--viewport" && a + 4 < argc) {
+            view_x = std::stoi(argv[++a]);
+            view_y = std::stoi(argv[++a]);
+            view_w = std::stoi(argv[++a]);
+            view_h = std::stoi(argv[++a]);
+        } else if (arg == "--density") {
+            density = true;
+        } else if (arg == "--kinds" && a + 1 < argc) {
+            kinds_path = argv[++a];
+        } else if (arg == "--flow") {
+            flow = true;
+        } else if (arg == "--tick-rate" && a + 1 < argc) {
+            tick_rate = std::stod(argv[++a]);
+        } else if (arg == "--npcs" && a + 1 < argc) {
+            npc_count = std::stoull(argv[++a]);
+        } else if (arg == "--export" && a + 1 < argc) {
+            export_name = argv[++a];
+        } else if (arg == "--log-level" && a + 1 < argc && parse_log_level(argv[a + 1], log_level)) {
+            ++a;
+        } else if (arg == "--file-log" && a + 1 < argc && parse_log_level(argv[a + 1], file_log_level)) {
+            ++a;
+        } else if (arg == "--log-sample" && a + 1 < argc) {
+            log_sample = static_cast<uint32_t>(std::stoul(argv[++a]));
+        } else if (arg == "--log-rate" && a + 1 < argc) {
+            log_rate = static_cast<uint32_t>(std::stoul(argv[++a]));
+        } else if (arg == "--log-summary") {
+            log_summary = true;
+        } else if (arg == "--record" && a + 1 < argc) {
+            record_path = argv[++a];
+        } else if (arg == "--replay" && a + 1 < argc) {
+            replay_path = argv[++a];
+        } else if (arg == "--replay-until" && a + 1 < argc) {
+            replay_until = std::stoull(argv[++a]);
+        } else {
+            std::cerr << "Usage: " << argv[0] << " [--restore FILE] [--checkpoint FILE] [--checkpoint-every TICKS]"
+                      << " [--viewport X Y W H] [--density] [--kinds FILE] [--flow] [--npcs N] [--tick-rate HZ]"
+                      << " [--export SHM_NAME] [--record FILE] [--replay FILE [--replay-until TICK]]"
+                      << " [--log-level LEVEL] [--file-log LEVEL] [--log-sample N] [--log-rate PER_SEC] [--log-summary]\n";
+            return 1;
+        }
+    }
 
-    std::set<std::shared_ptr<NPC>> npcs;
+    // Вывод сражений: фильтры консоли и log.txt (уровни debug, info, warning, off)
+    LogSink &console = console_log();
+    console.set_level(log_level);
+    console.set_sampling(log_sample);
+    console.set_rate_limit(log_rate);
+    if (log_summary) {
+        console.set_types(LogRecord::ALL & ~(LogRecord::bit(LogRecord::Kill) | LogRecord::bit(LogRecord::Murder)));
+    }
+    static_cast<FileObserver &>(*FileObserver::get()).sink().set_level(file_log_level);
 
-    auto text_observer = TextObserver::get();
-    auto file_observer = FileObserver::get();
+    KindRegistry &kinds = KindRegistry::instance();
+    if (!kinds_path.empty() && !kinds.load_file(kinds_path)) {
+        return 1;
+    }
 
-    std::cout << "Generating 50 NPCs..." << std::endl;
-    for (int i = 0; i < 50; ++i) {
-        NpcKind kind = static_cast<NpcKind>(1 + std::rand() % 3);
-        std::string name;
-        
-        switch(kind) {
-            case DragonType:
-                name = "Dragon_" + std::to_string(i);
-                break;
-            case BullType:
-                name = "Bull_" + std::to_string(i);
-                break;
-            case ToadType:
-                name = "Toad_" + std::to_string(i);
-                break;
+    // Повтор записанного прогона: без потоков, пауз и отрисовки, только итог
+    if (!replay_path.empty()) {
+        std::ifstream in(replay_path, std::ios::binary);
+        FightTrace trace;
+        if (!in || !read_trace(in, trace)) {
+            std::cerr << "Cannot read trace " << replay_path << "\n";
+            return 1;
         }
-        
-        auto npc = factory(kind, name, std::rand() % MAX_X, std::rand() % MAX_Y);
-        if (npc) {
-            npc->subscribe(text_observer);
-            npc->subscribe(file_observer);
-            npcs.insert(npc);
+        // Повтор идёт по таблице видов записи, а не по --kinds
+        if (!kinds.load_table(trace.start.kind_table, trace.start.kind_prey)) {
+            return 1;
+        }
+        Replay replay(trace);
+        if (!replay.valid()) {
+            return 1;
+        }
+        ReplayResult result = replay.run(replay_until);
+        std::cout << "Replayed ticks " << trace.start.tick << ".." << result.ticks << " in " << result.seconds << " s ("
+                  << result.resolves << " fight batches, " << result.kills << " kills)" << std::endl;
+        if (result.diverged) {
+            std::cout << "Diverged from the recording after tick " << result.divergence_tick << std::endl;
+        }
+        std::cout << "Alive: " << replay.simulation().world().alive() << std::endl;
+        return result.diverged ? 2 : 0;
+    }
+
+    std::unique_ptr<Simulation> sim;
+    if (!restore_path.empty()) {
+        std::ifstream in(restore_path, std::ios::binary);
+        WorldSnapshot snapshot;
+        // Таблица видов берётся из снимка и заменяет --kinds
+        if (!in || !read_snapshot(in, snapshot) || !kinds.load_table(snapshot.kind_table, snapshot.kind_prey)
+            || !(sim = Simulation::restore(snapshot))) {
+            std::cerr << "Cannot restore from " << restore_path << "\n";
+            return 1;
         }
+        std::cout << "Restored " << snapshot.size() << " NPCs at tick " << snapshot.tick << std::endl;
+    } else {
+        std::random_device seed_source;
+        sim = std::make_unique<Simulation>(MAX_X, MAX_Y, seed_source());
+
+        WorldSpec spec;
+        spec.count = npc_count;
+        spec.seed = seed_source();
+        spec.observers = {TextObserver::get(), FileObserver::get()};
+        std::cout << "Generating " << npc_count << " NPCs..." << std::endl;
+        auto generate_start = std::chrono::steady_clock::now();
+        generate_world(*sim, spec);
+        std::cout << "Generated in " << std::chrono::duration<double, std::milli>(
+            std::chrono::steady_clock::now() - generate_start).count() << " ms" << std::endl;
     }
+    sim->set_flow(flow);
+    sim->summarize_kills = log_summary;
+    World &world = sim->world();
+    const int total = static_cast<int>(world.size());
+    const int kind_count = static_cast<int>(kinds.size()) - 1;
 
     std::cout << "Game settings:" << std::endl;
     std::cout << "Map size: " << MAX_X << "x" << MAX_Y << std::endl;
     std::cout << "Game duration: 30 seconds" << std::endl;
+    std::cout << "Movement: " << (flow ? "flow fields" : "random walk") << std::endl;
     std::cout << "NPC types:" << std::endl;
-    std::cout << "  Dragon: step=" << DRAGON_MOVE_DISTANCE << ", kill radius=" << DRAGON_KILL_DISTANCE << std::endl;
-    std::cout << "  Bull: step=" << BULL_MOVE_DISTANCE << ", kill radius=" << BULL_KILL_DISTANCE << std::endl;
-    std::cout << "  Toad: step=" << TOAD_MOVE_DISTANCE << ", kill radius=" << TOAD_KILL_DISTANCE << std::endl;
+    for (int k = 1; k <= kind_count; ++k) {
+        std::cout << "  " << kinds.info(k).name << ": step=" << kinds.step(k)
+                  << ", kill radius=" << kinds.kill_radius(k) << std::endl;
+    }
+
+    FightTrace trace;
+    if (!record_path.empty()) {
+        sim->record(&trace);
+    }
+
+    FrameWriter exporter;
+    if (!export_name.empty()) {
+        if (!exporter.open(export_name, static_cast<uint32_t>(world.size()), MAX_X, MAX_Y, kinds)) {
+            return 1;
+        }
+        std::cout << "Exporting frames to shared memory " << export_name << std::endl;
+    }
 
     std::atomic_bool running{true};
-    FightManager manager(running);
+    FightManager manager(*sim, running, tick_rate);
+    TickClock move_clock(tick_rate);
+    // Пары, не разобранные до снимка, - первыми в очередь потока сражений
+    std::vector<FightEvent> restored_fights;
+    sim->take_restored_fights(restored_fights);
+    manager.add_events(restored_fights);
 
     std::thread fight_thread(std::ref(manager));
 
+    std::unique_ptr<Checkpointer> checkpointer;
+    if (!checkpoint_path.empty()) {
+        checkpointer = std::make_unique<Checkpointer>(checkpoint_path);
+    }
+
     std::thread move_thread([&]() {
-        std::mt19937 rng{std::random_device{}()};
+        std::vector<FightEvent> batch;
+        WorldSnapshot snapshot;
+        move_clock.start();
         while (running) {
-            // Перемещение NPC
-            for (auto &npc : npcs) {
-                if (!npc->is_alive()) {
-                    continue;
-                }
-                int s = npc->step();
-                std::uniform_int_distribution<int> dist(-s, s);
-                int dx = dist(rng);
-                int dy = dist(rng);
-                npc->move(dx, dy, MAX_X, MAX_Y);
-            }
+            sim->move_tick(batch);
+            exporter.publish(world, sim->ticks());
+            manager.add_events(batch);
 
-            // Проверка сражений
-            for (auto it_a = npcs.begin(); it_a != npcs.end(); ++it_a) {
-                auto &a = *it_a;
-                if (!a->is_alive()) {
-                    continue;
-                }
-                for (auto it_d = std::next(it_a); it_d != npcs.end(); ++it_d) {
-                    auto &d = *it_d;
-                    if (a == d || !d->is_alive()) {
-                        continue;
-                    }
-                    if (a->is_close(d, static_cast<size_t>(a->kill_radius()))) {
-                        manager.add_event(FightEvent{a, d});
-                    }
-                }
+            // Снимок - после передачи пар тика потоку сражений, вместе с его очередью; копируется
+            // в буфер здесь, а пишется на диск фоновым потоком
+            if (checkpointer && sim->ticks() % checkpoint_every == 0) {
+                auto capture_start = std::chrono::steady_clock::now();
+                sim->capture(snapshot, &manager);
+                double capture_ms = std::chrono::duration<double, std::milli>(
+                    std::chrono::steady_clock::now() - capture_start).count();
+                checkpointer->submit(snapshot, capture_ms);
             }
-            std::this_thread::sleep_for(10ms);
+
+            move_clock.wait();
         }
     });
 
     auto start = std::chrono::steady_clock::now();
-    std::array<char, GRID * GRID> field{};
     std::mutex global_cout_mutex;
+    MapRenderer renderer(GRID, GRID);
+    renderer.set_viewport(view_x, view_y, view_w, view_h);
+    renderer.set_density(density);
 
+    size_t skipped_frames = 0;
     while (std::chrono::steady_clock::now() - start < 30s) {
-        field.fill(' ');
-        for (auto &npc : npcs) {
-            if (!npc->is_alive()) {
-                continue;
-            }
-            auto [x, y] = npc->position();
-            int i = std::clamp(x / STEP_X, 0, GRID - 1);
-            int j = std::clamp(y / STEP_Y, 0, GRID - 1);
-
-            char c = '?';
-            if (std::dynamic_pointer_cast<Dragon>(npc)) {
-                c = 'D';
-            } else if (std::dynamic_pointer_cast<Bull>(npc)) {
-                c = 'B';
-            } else if (std::dynamic_pointer_cast<Toad>(npc)) {
-                c = 'T';
+        // Поток перемещения не успевает в свой темп - карту не перестраиваем, чтобы не отнимать
+        // у него мир; на экране остаётся прошлый кадр, обновляется только статус
+        bool skip_map = move_clock.overloaded();
+        if (skip_map) {
+            ++skipped_frames;
+        } else {
+            renderer.begin_frame();
+            auto world_lock = world.read_lock();
+            for (size_t n = 0; n < world.size(); ++n) {
+                NPC *npc = world.at(n);
+                if (!npc->is_alive()) {
+                    continue;
+                }
+                auto [x, y] = npc->position();
+                renderer.plot(x, y, kinds.glyph(world.kind_at(n)));
             }
-            field[i + j * GRID] = c;
         }
+        int alive = static_cast<int>(world.alive());
 
         {
             std::lock_guard<std::mutex> l(global_cout_mutex);
-            std::cout << "\n=== Game Map ===" << std::endl;
-            std::cout << "Time remaining: " 
-                      << 30 - std::chrono::duration_cast<std::chrono::seconds>(
-                          std::chrono::steady_clock::now() - start).count() 
-                      << "s" << std::endl;
-            
-            for (int j = 0; j < GRID; ++j) {
-                for (int i = 0; i < GRID; ++i) {
-                    char c = field[i + j * GRID];
-                    std::cout << '[' << (c == ' ' ? ' ' : c) << ']';
-                }
-                std::cout << '\n';
-            }
-            
-            // Статистика
-            int alive = 0;
-            int dragons = 0, bulls = 0, toads = 0;
-            for (auto &npc : npcs) {
-                if (npc->is_alive()) {
-                    alive++;
-                    if (std::dynamic_pointer_cast<Dragon>(npc)) dragons++;
-                    else if (std::dynamic_pointer_cast<Bull>(npc)) bulls++;
-                    else if (std::dynamic_pointer_cast<Toad>(npc)) toads++;
+            auto elapsed = std::chrono::duration_cast<std::chrono::seconds>(std::chrono::steady_clock::now() - start).count();
+            renderer.set_status(0, "Time remaining: " + std::to_string(30 - elapsed) + "s");
+            std::string alive_line = "Alive: " + std::to_string(alive) + " (";
+            for (int k = 1; k <= kind_count; ++k) {
+                if (k > 1) {
+                    alive_line.push_back(' ');
                 }
+                alive_line.push_back(kinds.glyph(k));
+                alive_line.push_back(':');
+                alive_line.append(std::to_string(world.population(k)));
             }
-            
-            std::cout << "\nStatistics:" << std::endl;
-            std::cout << "Alive: " << alive << " (D:" << dragons << " B:" << bulls << " T:" << toads << ")" << std::endl;
-            std::cout << "Dead: " << (50 - alive) << std::endl;
+            renderer.set_status(1, alive_line + ")");
+            renderer.set_status(2, "Dead: " + std::to_string(total - alive) + (skip_map ? "  (map paused: ticks overrun)" : ""));
+            std::cout.flush();
+            renderer.present();
         }
         
         std::this_thread::sleep_for(1s);
@@ -232,33 +282,64 @@ int main() {
     move_thread.join();
     fight_thread.join();
 
+    if (!record_path.empty()) {
+        sim->record(nullptr);
+        std::ofstream out(record_path, std::ios::binary);
+        write_trace(out, trace);
+        if (!out) {
+            std::cerr << "Cannot write trace " << record_path << "\n";
+        }
+    }
+
     {
         std::lock_guard<std::mutex> l(global_cout_mutex);
+        std::cout << renderer.finish();
         std::cout << "\n=== Game Over ===" << std::endl;
         std::cout << "=== Survivors ===" << std::endl;
         
-        int survivors = 0;
-        for (auto &npc : npcs) {
+        for (size_t n = 0; n < world.size(); ++n) {
+            NPC *npc = world.at(n);
             if (npc->is_alive()) {
                 npc->print();
-                survivors++;
-            }
-        }
-        std::cout << "\nTotal survivors: " << survivors << std::endl;
-    
-        int dragons = 0, bulls = 0, toads = 0;
-        for (auto &npc : npcs) {
-            if (npc->is_alive()) {
-                if (std::dynamic_pointer_cast<Dragon>(npc)) dragons++;
-                else if (std::dynamic_pointer_cast<Bull>(npc)) bulls++;
-                else if (std::dynamic_pointer_cast<Toad>(npc)) toads++;
             }
         }
+        std::cout << "\nTotal survivors: " << world.alive() << std::endl;
         
         std::cout << "By type:" << std::endl;
-        std::cout << "  Dragons: " << dragons << std::endl;
-        std::cout << "  Bulls: " << bulls << std::endl;
-        std::cout << "  Toads: " << toads << std::endl;
+        for (int k = 1; k <= kind_count; ++k) {
+            std::cout << "  " << kinds.info(k).name << "s: " << world.population(k) << std::endl;
+        }
+        {
+            auto lock = world.read_lock();
+            std::cout << sim->memory_report() << std::endl;
+        }
+
+        std::cout << "\nMove ticks at " << tick_rate << " Hz: " << move_clock.stats() << std::endl;
+        std::cout << "Fight ticks: " << manager.clock().stats() << std::endl;
+        if (exporter.mapped()) {
+            std::cout << "Frames exported: " << exporter.published() << std::endl;
+        }
+        LogSink::Stats log_stats = console.stats();
+        if (log_stats.sampled_out + log_stats.rate_limited > 0) {
+            std::cout << "Fight log: " << log_stats.written << " written, " << log_stats.sampled_out << " sampled out, "
+                      << log_stats.rate_limited << " over the rate limit" << std::endl;
+        }
+        if (skipped_frames > 0) {
+            std::cout << "Map frames skipped under load: " << skipped_frames << std::endl;
+        }
+
+        if (checkpointer) {
+            checkpointer->flush();
+            auto stats = checkpointer->stats();
+            std::cout << "\nCheckpoints: " << stats.written << " written, " << stats.skipped << " skipped" << std::endl;
+            if (stats.written > 0) {
+                std::cout << "  capture on tick thread: avg " << stats.capture_ms_total / stats.written
+                          << " ms, max " << stats.capture_ms_max << " ms" << std::endl;
+                std::cout << "  background write: avg " << stats.write_ms_total / stats.written
+                          << " ms, max " << stats.write_ms_max << " ms, "
+                          << stats.bytes / stats.written << " bytes each" << std::endl;
+            }
+        }
     }
     
     return 0;
@@ -1,14 +1,22 @@
 #include "npc.h"
-#include <cmath>
-#include <shared_mutex>
+#include "proximity.h"
+#include "kind_registry.h"
+#include <algorithm>
+#include <limits>
 
-NPC::NPC(const std::string &name_, int x_, int y_)
-    : name(name_), x(x_), y(y_) {}
+NPC::NPC(NpcKind kind_) : kind_tag(kind_) {}
+
+NPC::NPC(NpcKind kind_, const std::string &name_, int x_, int y_)
+    : name(name_), x(x_), y(y_), kind_tag(kind_) {}
 
 void NPC::subscribe(std::shared_ptr<IFightObserver> observer) {
     observers.push_back(observer);
 }
 
+void NPC::unsubscribe_all() {
+    observers.clear();
+}
+
 void NPC::fight_notify(const NPC_ptr &defender, bool win) {
     for (auto &o : observers){
         if (o){
@@ -17,23 +25,50 @@ void NPC::fight_notify(const NPC_ptr &defender, bool win) {
     }
 }
 
+uint32_t NPC::lock_position() {
+    uint32_t seq = pos_seq.load(std::memory_order_relaxed);
+    // acquire: записи x, y после захвата не переставляются раньше него
+    while ((seq & 1) || !pos_seq.compare_exchange_weak(seq, seq + 1, std::memory_order_acquire,
+                                                       std::memory_order_relaxed)) {
+        seq = pos_seq.load(std::memory_order_relaxed);
+    }
+    return seq;
+}
+
 std::pair<int, int> NPC::position() const {
-    std::shared_lock lock(mtx_pos);
-    return {x, y};
+    while (true) {
+        uint32_t seq = pos_seq.load(std::memory_order_acquire);
+        if (seq & 1) {
+            continue;
+        }
+        // Прочитав значение из release-записи move(), повторное чтение увидит и нечётный счётчик
+        // этого move(), так что смесь старого и нового положения не пройдёт проверку
+        int px = load_acquire(x);
+        int py = load_acquire(y);
+        if (pos_seq.load(std::memory_order_relaxed) == seq) {
+            return {px, py};
+        }
+    }
 }
 
 void NPC::move(int dx, int dy, int max_x, int max_y) {
-    std::unique_lock lock(mtx_pos);
+    uint32_t seq = lock_position();
     int new_x = x + dx;
     int new_y = y + dy;
 
-    if (new_x < 0) x = 0;
-    else if (new_x >= max_x) x = max_x - 1;
-    else x = new_x;
+    if (new_x < 0) new_x = 0;
+    else if (new_x >= max_x) new_x = max_x - 1;
+
+    if (new_y < 0) new_y = 0;
+    else if (new_y >= max_y) new_y = max_y - 1;
 
-    if (new_y < 0) y = 0;
-    else if (new_y >= max_y) y = max_y - 1;
-    else y = new_y;
+    store_release(x, new_x);
+    store_release(y, new_y);
+    if (hot) {
+        store_relaxed(hot->x, new_x);
+        store_relaxed(hot->y, new_y);
+    }
+    unlock_position(seq);
 }
 
 bool NPC::is_alive() const {
@@ -41,22 +76,109 @@ bool NPC::is_alive() const {
 }
 
 void NPC::must_die() {
-    alive = false;
+    // exchange гарантирует, что повторная или параллельная смерть не уменьшит счётчик дважды
+    if (!alive.exchange(false)) {
+        return;
+    }
+    if (hot) {
+        std::atomic_ref<uint8_t>(hot->alive).store(0, std::memory_order_relaxed);
+    }
+    if (population) {
+        population->by_kind[kind_tag].fetch_sub(1, std::memory_order_relaxed);
+        population->total.fetch_sub(1, std::memory_order_relaxed);
+    }
+}
+
+void NPC::track(Population *counters) {
+    if (is_alive()) {
+        if (population) {
+            population->by_kind[kind_tag].fetch_sub(1, std::memory_order_relaxed);
+            population->total.fetch_sub(1, std::memory_order_relaxed);
+        }
+        if (counters) {
+            counters->by_kind[kind_tag].fetch_add(1, std::memory_order_relaxed);
+            counters->total.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+    population = counters;
 }
 
-bool NPC::is_close(const std::shared_ptr<NPC> &other, size_t distance) const {
-    if (std::pow(x - other->x, 2) + std::pow(y - other->y, 2) <= std::pow(distance, 2)){
-        return true;
+void NPC::bind(PackedNpc *slot) {
+    uint32_t seq = lock_position();
+    hot = slot;
+    if (hot) {
+        *hot = PackedNpc{x, y, static_cast<uint8_t>(kind_tag), static_cast<uint8_t>(is_alive()), 0};
     }
-    else{return false;}
+    unlock_position(seq);
+}
+
+size_t NPC::footprint() const {
+    // make_shared кладёт объект и счётчики ссылок в одну аллокацию; наследники полей не добавляют
+    constexpr size_t control_block = 2 * sizeof(void *);
+    size_t bytes = control_block + sizeof(NPC);
+    if (name.capacity() > std::string().capacity()) {
+        bytes += name.capacity() + 1;
+    }
+    bytes += observers.capacity() * sizeof(observers[0]);
+    return bytes;
+}
+
+size_t NPC::is_close(std::span<const NPC_ptr> others, size_t distance, std::vector<uint32_t> &hits) const {
+    // Соседи могут двигаться в других потоках: свои координаты берутся один раз через position(),
+    // чужие - relaxed-чтениями, как в проверке одного NPC
+    auto [px, py] = position();
+    Reach reach = reach_of(clamp_radius(distance));
+    size_t before = hits.size();
+    uint32_t index = 0;
+    for (const NPC_ptr &other : others) {
+        if (within_reach(px, py, relaxed(other->x), relaxed(other->y), reach)) {
+            hits.push_back(index);
+        }
+        ++index;
+    }
+    return hits.size() - before;
+}
+
+Reach NPC::kill_reach() const {
+    return KindRegistry::instance().kill_reach(kind_tag);
+}
+
+std::string NPC::get_name() const {
+    if (!name.empty()) {
+        return name;
+    }
+    return KindRegistry::instance().info(kind_tag).name + "_" + std::to_string(serial);
+}
+
+void NPC::write_name(TextBuffer &out) const {
+    if (!name.empty()) {
+        out << name;
+    } else {
+        out << KindRegistry::instance().info(kind_tag).name << '_' << serial;
+    }
+}
+
+void NPC::describe_as(TextBuffer &out, std::string_view label) const {
+    out << label << ": { name: ";
+    write_name(out);
+    out << ", x: " << relaxed(x) << ", y: " << relaxed(y) << " }";
+}
+
+void NPC::print() const {
+    TextBuffer &out = TextBuffer::local();
+    out.clear();
+    describe(out);
+    out << '\n';
+    std::cout.write(out.view().data(), static_cast<std::streamsize>(out.size()));
+    std::cout.flush();
 }
 
 void NPC::save(std::ostream &os) const {
-    os << name << std::endl;
+    os << get_name() << std::endl;
     os << x << " " << y << std::endl;
 }
 
 std::ostream &operator<<(std::ostream &os, const NPC &npc){
-    os << "{ name: " << npc.name << ", x: " << npc.x << ", y: " << npc.y << " }";
+    os << "{ name: " << npc.get_name() << ", x: " << npc.x << ", y: " << npc.y << " }";
     return os;
 }
\ No newline at end of file
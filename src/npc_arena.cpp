@@ -0,0 +1,29 @@
+#include "npc_arena.h"
+#include <cstdlib>
+#include <new>
+#include <sys/mman.h>
+
+void *NpcArena::allocate(size_t bytes, size_t align) {
+    size_t offset = (used + align - 1) / align * align;
+    if (offset + bytes > BLOCK_BYTES) {
+        if (bytes > BLOCK_BYTES) {
+            throw std::bad_alloc();
+        }
+        std::unique_ptr<std::byte, Free> block(static_cast<std::byte *>(std::aligned_alloc(BLOCK_BYTES, BLOCK_BYTES)));
+        if (!block) {
+            throw std::bad_alloc();
+        }
+        // Блок - ровно одна большая страница: мир из 10^6 NPC - сотни отказов страниц, а не десятки тысяч
+        madvise(block.get(), BLOCK_BYTES, MADV_HUGEPAGE);
+        storage.push_back(std::move(block));
+        offset = 0;
+    }
+    used = offset + bytes;
+    return storage.back().get() + offset;
+}
+
+void NpcArena::release() {
+    if (refs.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+        delete this;
+    }
+}
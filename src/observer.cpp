@@ -1,11 +1,4 @@
 #include "observer.h"
-#include <iostream>
-#include <fstream>
-#include <mutex>
-
-namespace {
-    std::mutex print_mutex;
-}
 
 std::shared_ptr<IFightObserver> TextObserver::get() {
     static TextObserver instance;
@@ -13,15 +6,21 @@ std::shared_ptr<IFightObserver> TextObserver::get() {
 }
 
 void TextObserver::on_fight(const NPC_ptr &attacker, const NPC_ptr &defender, bool win) {
-  if (win) {
-    std::lock_guard<std::mutex> lck(print_mutex);
-    std::cout << std::endl << "Murder --------" << std::endl;
-    attacker->print();
-    defender->print();
-  }
+    if (win) {
+        console_log().submit(LogRecord{LogRecord::Murder, attacker.get(), defender.get()});
+    }
 }
 
-FileObserver::FileObserver() { logfile.open("log.txt", std::ios::app); }
+FileObserver::FileObserver() : log(log_path(), LogFormat::Compact) {}
+
+std::string &FileObserver::log_path() {
+    static std::string path = "log.txt";
+    return path;
+}
+
+void FileObserver::set_path(std::string path) {
+    log_path() = std::move(path);
+}
 
 std::shared_ptr<IFightObserver> FileObserver::get() {
     static FileObserver instance;
@@ -29,10 +28,7 @@ std::shared_ptr<IFightObserver> FileObserver::get() {
 }
 
 void FileObserver::on_fight(const NPC_ptr &attacker, const NPC_ptr &defender, bool win) {
-    if (!logfile.is_open()) {return;}
     if (win) {
-        logfile << "Murder --------" << std::endl;
-        logfile << attacker->name << " vs " << defender->name << std::endl;
+        log.submit(LogRecord{LogRecord::Murder, attacker.get(), defender.get()});
     }
-    logfile.flush();
-}
\ No newline at end of file
+}
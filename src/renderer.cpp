@@ -0,0 +1,173 @@
+#include "renderer.h"
+#include <algorithm>
+#include <cerrno>
+#include <charconv>
+#include <unistd.h>
+
+namespace {
+    // Первая строка экрана - заголовок, карта начинается со второй
+    constexpr int MAP_TOP = 2;
+    constexpr std::string_view TITLE = "=== Game Map ===";
+}
+
+MapRenderer::MapRenderer(int cols_, int rows_, int status_lines_)
+    : cols_n(cols_), rows_n(rows_),
+      counts(static_cast<size_t>(cols_) * rows_, 0),
+      glyphs(counts.size(), ' '),
+      shown(counts.size(), ' '),
+      status(status_lines_),
+      shown_status(status_lines_) {
+    set_viewport(0, 0, cols_, rows_);
+    out.reserve(counts.size() * 3 + static_cast<size_t>(rows_) * 16 + static_cast<size_t>(status_lines_) * 256 + 64);
+}
+
+void MapRenderer::set_viewport(int x0, int y0, int width, int height) {
+    view_x = x0;
+    view_y = y0;
+    view_w = std::max(1, width);
+    view_h = std::max(1, height);
+}
+
+void MapRenderer::begin_frame() {
+    std::fill(counts.begin(), counts.end(), 0);
+    std::fill(glyphs.begin(), glyphs.end(), ' ');
+}
+
+void MapRenderer::plot(int x, int y, char glyph) {
+    int64_t dx = static_cast<int64_t>(x) - view_x;
+    int64_t dy = static_cast<int64_t>(y) - view_y;
+    if (dx < 0 || dy < 0 || dx >= view_w || dy >= view_h) {
+        return;
+    }
+    size_t col = static_cast<size_t>(dx * cols_n / view_w);
+    size_t row = static_cast<size_t>(dy * rows_n / view_h);
+    size_t cell = row * cols_n + col;
+    ++counts[cell];
+    glyphs[cell] = glyph;
+}
+
+void MapRenderer::set_status(int line, std::string_view text) {
+    if (line >= 0 && line < static_cast<int>(status.size())) {
+        status[line].assign(text);
+    }
+}
+
+char MapRenderer::cell_char(size_t cell) const {
+    if (!density) {
+        return glyphs[cell];
+    }
+    uint32_t n = counts[cell];
+    return n == 0 ? ' ' : n <= 9 ? static_cast<char>('0' + n) : '+';
+}
+
+void MapRenderer::move_to(int row, int col) {
+    char num[16];
+    out += "\x1b[";
+    auto res = std::to_chars(num, num + sizeof(num), row);
+    out.append(num, static_cast<size_t>(res.ptr - num));
+    out += ';';
+    res = std::to_chars(num, num + sizeof(num), col);
+    out.append(num, static_cast<size_t>(res.ptr - num));
+    out += 'H';
+    cursor_row = row;
+    cursor_col = col;
+}
+
+std::string_view MapRenderer::compose() {
+    out.clear();
+    int status_top = MAP_TOP + rows_n;
+    int scroll_top = status_top + static_cast<int>(status.size()) + 1;
+
+    if (full_redraw) {
+        out += "\x1b[2J";
+        // Область прокрутки для остального вывода - под картой и статусом
+        char num[16];
+        out += "\x1b[";
+        out.append(num, std::to_chars(num, num + sizeof(num), scroll_top).ptr);
+        out += 'r';
+
+        move_to(1, 1);
+        out += TITLE;
+        for (int r = 0; r < rows_n; ++r) {
+            move_to(MAP_TOP + r, 1);
+            for (int c = 0; c < cols_n; ++c) {
+                size_t cell = static_cast<size_t>(r) * cols_n + c;
+                shown[cell] = cell_char(cell);
+                out += '[';
+                out += shown[cell];
+                out += ']';
+            }
+        }
+        for (size_t i = 0; i < status.size(); ++i) {
+            move_to(status_top + static_cast<int>(i), 1);
+            out += status[i];
+            shown_status[i] = status[i];
+        }
+        move_to(scroll_top, 1);
+        full_redraw = false;
+        return out;
+    }
+
+    cursor_row = cursor_col = -1;
+    for (int r = 0; r < rows_n; ++r) {
+        for (int c = 0; c < cols_n; ++c) {
+            size_t cell = static_cast<size_t>(r) * cols_n + c;
+            char ch = cell_char(cell);
+            if (ch == shown[cell]) {
+                continue;
+            }
+            if (out.empty()) {
+                out += "\x1b" "7";
+            }
+            int row = MAP_TOP + r;
+            int col = 3 * c + 2;
+            // Соседняя клетка той же строки: дописать "][" дешевле, чем двигать курсор
+            if (cursor_row == row && cursor_col == col - 2) {
+                out += "][";
+            } else {
+                move_to(row, col);
+            }
+            out += ch;
+            cursor_col = col + 1;
+            shown[cell] = ch;
+        }
+    }
+    for (size_t i = 0; i < status.size(); ++i) {
+        if (status[i] == shown_status[i]) {
+            continue;
+        }
+        if (out.empty()) {
+            out += "\x1b" "7";
+        }
+        move_to(status_top + static_cast<int>(i), 1);
+        out += status[i];
+        out += "\x1b[K";
+        shown_status[i] = status[i];
+    }
+    if (!out.empty()) {
+        out += "\x1b" "8";
+    }
+    return out;
+}
+
+void MapRenderer::present(int fd) {
+    std::string_view frame = compose();
+    while (!frame.empty()) {
+        ssize_t n = ::write(fd, frame.data(), frame.size());
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return;
+        }
+        frame.remove_prefix(static_cast<size_t>(n));
+    }
+}
+
+std::string_view MapRenderer::finish() {
+    out.assign("\x1b[r");
+    move_to(999, 1);
+    out += '\n';
+    full_redraw = true;
+    return out;
+}
@@ -0,0 +1,102 @@
+#include "replay.h"
+#include <chrono>
+#include <cstring>
+
+namespace {
+    constexpr char MAGIC[8] = {'N', 'P', 'C', 'T', 'R', 'C', 'E', '1'};
+
+    template <typename T>
+    void put(std::ostream &os, const T &value) {
+        os.write(reinterpret_cast<const char *>(&value), sizeof(T));
+    }
+
+    template <typename T>
+    bool get(std::istream &is, T &value) {
+        return static_cast<bool>(is.read(reinterpret_cast<char *>(&value), sizeof(T)));
+    }
+}
+
+void write_trace(std::ostream &os, const FightTrace &trace) {
+    os.write(MAGIC, sizeof(MAGIC));
+    put(os, static_cast<uint8_t>(trace.flow));
+    put(os, trace.end_tick);
+    write_snapshot(os, trace.start);
+    put(os, static_cast<uint64_t>(trace.resolves.size()));
+    os.write(reinterpret_cast<const char *>(trace.resolves.data()),
+             static_cast<std::streamsize>(trace.resolves.size() * sizeof(FightTrace::Resolve)));
+}
+
+bool read_trace(std::istream &is, FightTrace &trace) {
+    char magic[sizeof(MAGIC)];
+    if (!is.read(magic, sizeof(magic)) || std::memcmp(magic, MAGIC, sizeof(MAGIC)) != 0) {
+        std::cerr << "Not a trace file\n";
+        return false;
+    }
+    uint8_t flow = 0;
+    uint64_t count = 0;
+    if (!get(is, flow) || !get(is, trace.end_tick) || !read_snapshot(is, trace.start) || !get(is, count)) {
+        std::cerr << "Truncated trace\n";
+        return false;
+    }
+    trace.flow = flow != 0;
+    trace.resolves.resize(count);
+    if (!is.read(reinterpret_cast<char *>(trace.resolves.data()),
+                 static_cast<std::streamsize>(count * sizeof(FightTrace::Resolve)))) {
+        std::cerr << "Truncated trace\n";
+        return false;
+    }
+    return true;
+}
+
+Replay::Replay(const FightTrace &trace_, const KindRegistry &registry)
+    : trace(trace_), sim(Simulation::restore(trace_.start, registry)) {
+    if (sim) {
+        sim->set_flow(trace.flow);
+        sim->print_kills = false;
+        // Пары, переданные потоку сражений до начала записи, стоят в очереди первыми
+        sim->take_restored_fights(queue);
+        // factory подписывает NPC на вывод сражений - при повторе он только мешает замерам
+        World &world = sim->world();
+        for (size_t i = 0; i < world.size(); ++i) {
+            world.at(i)->unsubscribe_all();
+        }
+    }
+}
+
+ReplayResult Replay::run(uint64_t until) {
+    auto start = std::chrono::steady_clock::now();
+    until = std::min(until, trace.end_tick);
+    size_t head = 0;
+    while (true) {
+        // Сначала разборы, которые поток сражений сделал после уже пройденного тика
+        if (next_resolve < trace.resolves.size() && trace.resolves[next_resolve].tick <= sim->ticks()) {
+            const FightTrace::Resolve &point = trace.resolves[next_resolve++];
+            size_t take = std::min<size_t>(point.events, queue.size() - head);
+            batch.assign(queue.begin() + head, queue.begin() + head + take);
+            head += take;
+            size_t kills = sim->resolve(batch);
+            result.kills += kills;
+            ++result.resolves;
+            if (!result.diverged && (kills != point.kills || take != point.events)) {
+                result.diverged = true;
+                result.divergence_tick = point.tick;
+            }
+            continue;
+        }
+        if (sim->ticks() >= until) {
+            break;
+        }
+        // Разобранные пары больше не нужны - сдвигаем очередь, пока она не разрослась
+        if (head > 0 && head * 2 >= queue.size()) {
+            queue.erase(queue.begin(), queue.begin() + head);
+            head = 0;
+        }
+        batch.clear();
+        sim->move_tick(batch);
+        queue.insert(queue.end(), batch.begin(), batch.end());
+    }
+    queue.erase(queue.begin(), queue.begin() + head);
+    result.ticks = sim->ticks();
+    result.seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return result;
+}
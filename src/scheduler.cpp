@@ -0,0 +1,202 @@
+#include "scheduler.h"
+#include <algorithm>
+#include <new>
+
+namespace {
+    thread_local FramePool *active_pool = nullptr;
+}
+
+FramePool::Scope::Scope(FramePool &pool) : previous(std::exchange(active_pool, &pool)) {}
+
+FramePool::Scope::~Scope() {
+    active_pool = previous;
+}
+
+FramePool *FramePool::current() {
+    return active_pool;
+}
+
+void *FramePool::allocate(size_t size) {
+    // Кадры в блоке идут подряд - размер округляется до выравнивания operator new
+    constexpr size_t align = __STDCPP_DEFAULT_NEW_ALIGNMENT__;
+    size = std::max((size + align - 1) / align * align, sizeof(FreeFrame));
+    if (frame_size == 0) {
+        frame_size = size;
+    }
+    if (size != frame_size) {
+        return nullptr;
+    }
+    if (free_frames) {
+        return std::exchange(free_frames, free_frames->next);
+    }
+    if (slab_used == FRAMES_PER_SLAB) {
+        blocks.push_back(std::make_unique_for_overwrite<std::byte[]>(frame_size * FRAMES_PER_SLAB));
+        slab_used = 0;
+    }
+    return blocks.back().get() + frame_size * slab_used++;
+}
+
+void FramePool::release(void *frame) {
+    free_frames = new (frame) FreeFrame{free_frames};
+}
+
+void *Behaviour::promise_type::operator new(size_t size) {
+    FramePool *pool = FramePool::current();
+    void *block = pool ? pool->allocate(size + FRAME_HEADER) : nullptr;
+    if (!block) {
+        block = ::operator new(size + FRAME_HEADER);
+        pool = nullptr;
+    }
+    *static_cast<FramePool **>(block) = pool;
+    return static_cast<std::byte *>(block) + FRAME_HEADER;
+}
+
+void Behaviour::promise_type::operator delete(void *frame, size_t) {
+    void *block = static_cast<std::byte *>(frame) - FRAME_HEADER;
+    if (FramePool *pool = *static_cast<FramePool **>(block)) {
+        pool->release(block);
+    } else {
+        ::operator delete(block);
+    }
+}
+
+Behaviour &Behaviour::operator=(Behaviour &&other) noexcept {
+    if (this != &other) {
+        if (handle) {
+            handle.destroy();
+        }
+        handle = std::exchange(other.handle, {});
+    }
+    return *this;
+}
+
+Behaviour::~Behaviour() {
+    if (handle) {
+        handle.destroy();
+    }
+}
+
+Scheduler::Scheduler() : wheel(WHEEL_SIZE) {}
+
+Scheduler::~Scheduler() {
+    for (auto h : live) {
+        h.destroy();
+    }
+}
+
+void Scheduler::spawn(Behaviour behaviour, uint64_t tag, uint64_t delay) {
+    Behaviour::Handle h = behaviour.release();
+    if (!h) {
+        return;
+    }
+    h.promise().scheduler = this;
+    h.promise().tag = tag;
+    h.promise().live_index = live.size();
+    live.push_back(h);
+    schedule(h, delay);
+}
+
+void Scheduler::reserve(size_t count) {
+    live.reserve(live.size() + count);
+    std::vector<Entry> &bucket = wheel[current % WHEEL_SIZE];
+    bucket.reserve(bucket.size() + count);
+}
+
+void Scheduler::schedule(Behaviour::Handle h, uint64_t ticks, std::function<bool()> condition, uint32_t poll_every) {
+    uint32_t slot = NO_CONDITION;
+    if (condition) {
+        if (free_conditions.empty()) {
+            slot = static_cast<uint32_t>(conditions.size());
+            conditions.push_back(std::move(condition));
+        } else {
+            slot = free_conditions.back();
+            free_conditions.pop_back();
+            conditions[slot] = std::move(condition);
+        }
+    }
+    enqueue(h, ticks, slot, poll_every);
+}
+
+void Scheduler::enqueue(Behaviour::Handle h, uint64_t ticks, uint32_t condition, uint32_t poll_every) {
+    uint64_t due = current + ticks;
+    wheel[due % WHEEL_SIZE].push_back(Entry{h, due, condition, poll_every == 0 ? 1 : poll_every});
+}
+
+void Scheduler::pending(std::vector<Wakeup> &wakeups) const {
+    size_t first = wakeups.size();
+    // Записи одного тика лежат в одной корзине в порядке возобновления - устойчивая сортировка его сохраняет
+    for (uint32_t b = 0; b < WHEEL_SIZE; ++b) {
+        for (auto &e : wheel[(current + b) % WHEEL_SIZE]) {
+            wakeups.push_back(Wakeup{e.handle.promise().tag, e.due - current});
+        }
+    }
+    std::stable_sort(wakeups.begin() + static_cast<std::ptrdiff_t>(first), wakeups.end(),
+                     [](const Wakeup &a, const Wakeup &b) {return a.delay < b.delay;});
+}
+
+size_t Scheduler::memory_bytes() const {
+    size_t bytes = wheel.capacity() * sizeof(std::vector<Entry>) + due_now.capacity() * sizeof(Entry);
+    for (auto &bucket : wheel) {
+        bytes += bucket.capacity() * sizeof(Entry);
+    }
+    // Захваты условий, не поместившиеся в std::function, не считаются
+    bytes += conditions.capacity() * sizeof(std::function<bool()>) + free_conditions.capacity() * sizeof(uint32_t);
+    return bytes + live.capacity() * sizeof(Behaviour::Handle);
+}
+
+size_t Scheduler::tick() {
+    size_t resumed = 0;
+    std::vector<Entry> &bucket = wheel[current % WHEEL_SIZE];
+
+    // Повторяем, пока в корзину добавляются записи на текущий тик (spawn, Event::signal)
+    while (true) {
+        due_now.clear();
+        size_t keep = 0;
+        for (auto &e : bucket) {
+            if (e.due == current) {
+                due_now.push_back(std::move(e));
+            } else {
+                bucket[keep++] = std::move(e);
+            }
+        }
+        bucket.resize(keep);
+        if (due_now.empty()) {
+            break;
+        }
+
+        for (auto &e : due_now) {
+            if (e.condition != NO_CONDITION) {
+                if (!conditions[e.condition]()) {
+                    enqueue(e.handle, e.poll_every, e.condition, e.poll_every);
+                    continue;
+                }
+                conditions[e.condition] = nullptr;
+                free_conditions.push_back(e.condition);
+            }
+            e.handle.resume();
+            ++resumed;
+            if (e.handle.done()) {
+                finish(e.handle);
+            }
+        }
+    }
+
+    ++current;
+    return resumed;
+}
+
+void Scheduler::finish(Behaviour::Handle h) {
+    size_t index = h.promise().live_index;
+    live[index] = live.back();
+    live[index].promise().live_index = index;
+    live.pop_back();
+    h.destroy();
+}
+
+void Event::signal() {
+    fired = true;
+    for (auto h : waiters) {
+        h.promise().scheduler->schedule(h, 0);
+    }
+    waiters.clear();
+}
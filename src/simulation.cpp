@@ -0,0 +1,458 @@
+#include "simulation.h"
+#include <algorithm>
+#include <bit>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <sstream>
+#include <thread>
+#include "factory.h"
+#include "replay.h"
+#include "locality.h"
+
+namespace {
+    uint64_t pack(EntityId id) {
+        return (static_cast<uint64_t>(id.generation) << 32) | id.index;
+    }
+
+    EntityId unpack(uint64_t tag) {
+        return {static_cast<uint32_t>(tag), static_cast<uint32_t>(tag >> 32)};
+    }
+
+    // Один шаг блуждания. Вынесен из корутины: её кадр хранит только то, что живёт через co_await.
+    // В режиме полей направлений по осям, где поле задаёт направление, берётся только модуль смещения
+    void wander_step(Simulation &sim, NPC &npc, int kind, std::mt19937 &rng) {
+        int s = sim.kinds().step(kind);
+        std::uniform_int_distribution<int> dist(-s, s);
+        int dx = dist(rng);
+        int dy = dist(rng);
+        if (const FlowField *flow = sim.flow_field()) {
+            auto [dir_x, dir_y] = flow->direction(npc.x, npc.y, kind);
+            dx = dir_x ? dir_x * std::abs(dx) : dx;
+            dy = dir_y ? dir_y * std::abs(dy) : dy;
+        }
+        npc.move(dx, dy, sim.max_x(), sim.max_y());
+    }
+
+    // Блуждание NPC: корутина живёт, пока жив её NPC, кадр берётся из пула планировщика sim.
+    // Решение о сне принимается в начале каждого круга только по состоянию мира, поэтому
+    // корутина, заново запущенная из снимка, продолжает так же, как прерванная
+    Behaviour wander(Simulation &sim, EntityId id, int kind, std::mt19937 &rng) {
+        World &world = sim.world();
+        for (NPC *npc = world.get(id); npc && npc->is_alive(); npc = world.get(id)) {
+            if (!sim.has_counterparts(kind)) {
+                co_await wait_until([&sim, kind] {return sim.has_counterparts(kind);}, Simulation::IDLE_POLL_TICKS);
+                continue;
+            }
+            if (uint32_t idle = sim.idle_ticks(npc->x, npc->y, kind)) {
+                co_await wait_ticks(idle);
+                continue;
+            }
+            wander_step(sim, *npc, kind, rng);
+            co_await wait_ticks(1);
+        }
+    }
+
+    // Сетка присутствия не больше чем в несколько раз крупнее числа NPC
+    constexpr size_t PRESENCE_CELLS_PER_NPC = 4;
+}
+
+Simulation::Simulation(int width, int height, uint32_t seed, const KindRegistry &registry_)
+    : registry(registry_), index(registry_), flow(registry_), max_x_(width), max_y_(height), move_rng(seed), dice(seed ^ 0x9e3779b9u) {}
+
+EntityId Simulation::spawn(NPC_ptr npc) {
+    int kind = npc->kind();
+    EntityId id = world_.spawn(std::move(npc));
+    FramePool::Scope frames(scheduler.frame_pool());
+    scheduler.spawn(wander(*this, id, kind, move_rng), pack(id));
+    return id;
+}
+
+void Simulation::spawn(std::span<const NPC_ptr> batch) {
+    std::vector<EntityId> ids;
+    world_.spawn(batch, ids);
+    scheduler.reserve(batch.size());
+    FramePool::Scope frames(scheduler.frame_pool());
+    for (size_t i = 0; i < batch.size(); ++i) {
+        scheduler.spawn(wander(*this, ids[i], batch[i]->kind(), move_rng), pack(ids[i]));
+    }
+}
+
+void Simulation::move_tick(std::vector<FightEvent> &events) {
+    std::unique_lock<std::mutex> record_lock(fight_mtx, std::defer_lock);
+    if (trace) {
+        record_lock.lock();
+    }
+    // Освобождаем слоты погибших: их id становятся недействительными
+    world_.collect();
+    // Соседи по карте разошлись в памяти - снова раскладываем их рядом. Проверка зависит
+    // только от тика и положений, так что повтор и восстановление из снимка сортируют там же
+    if (reorder_threshold > 0 && tick_count % REORDER_CHECK_TICKS == 0) {
+        bool disordered;
+        {
+            auto lock = world_.read_lock();
+            disordered = morton_disorder(world_) > reorder_threshold;
+            if (disordered) {
+                morton_order(world_, order);
+            }
+        }
+        if (disordered) {
+            world_.reorder(order);
+            ++reorder_count;
+        }
+    }
+
+    auto lock = world_.read_lock();
+    // Поля направлений - по положениям на начало тика, до любых перемещений
+    if (flow_mode) {
+        flow.rebuild(world_, max_x_, max_y_, 0, flow_threads);
+    }
+    rebuild_presence();
+    // Перемещение NPC: возобновляются только корутины, чьё время пришло
+    last_resumed = scheduler.tick();
+
+    // Проверка сражений: виды без жертв не проверяются, кандидаты берутся из сетки
+    // уже отфильтрованными матрицей видов. Как и при полном переборе, NPC атакует только
+    // тех, кто стоит после него в плотном массиве, и пары идут в порядке (i, j).
+    index.rebuild(world_);
+    size_t first = events.size();
+    for (size_t i = 0; i < world_.size(); ++i) {
+        const PackedNpc &a = world_.hot_at(i);
+        int kind = a.kind;
+        if (!registry.is_predator(kind) || !world_.alive_at(i)) {
+            continue;
+        }
+        hits.clear();
+        index.radius(a.x, a.y, registry.kill_radius(kind), hits, registry.prey_mask(kind));
+        std::sort(hits.begin(), hits.end());
+        for (uint32_t j : hits) {
+            if (j > i && world_.alive_at(j)) {
+                events.push_back(FightEvent{world_.id_at(i), world_.id_at(j)});
+            }
+        }
+    }
+    // Кости для всех пар тика - одним проходом по массивам
+    size_t found = events.size() - first;
+    attack_rolls.resize(found);
+    defense_rolls.resize(found);
+    dice.roll(tick_count, 0, attack_rolls, defense_rolls);
+    for (size_t e = 0; e < found; ++e) {
+        events[first + e].attack = attack_rolls[e];
+        events[first + e].defense = defense_rolls[e];
+    }
+    ++tick_count;
+}
+
+void Simulation::rebuild_presence() {
+    size_t kinds = registry.size();
+    counterparts.assign(kinds, 0);
+    for (size_t a = 1; a < kinds; ++a) {
+        uint64_t prey = registry.prey_mask(static_cast<int>(a));
+        counterparts[a] |= prey;
+        for (size_t d = 1; d < kinds; ++d) {
+            if (prey >> d & 1) {
+                counterparts[d] |= uint64_t{1} << a;
+            }
+        }
+    }
+    approach.assign(kinds, 1);
+    reach.assign(kinds, 0);
+    int widest = 1;
+    for (size_t k = 1; k < kinds; ++k) {
+        int kind = static_cast<int>(k);
+        int fastest = 0;
+        int far = registry.prey_mask(kind) ? registry.kill_radius(kind) : 0;
+        for (size_t o = 1; o < kinds; ++o) {
+            if (counterparts[k] >> o & 1) {
+                fastest = std::max(fastest, registry.step(static_cast<int>(o)));
+                if (registry.can_kill(static_cast<int>(o), kind)) {
+                    far = std::max(far, registry.kill_radius(static_cast<int>(o)));
+                }
+            }
+        }
+        // За тик NPC сдвигается не больше чем на step по каждой оси, то есть меньше чем на 1.5 * step
+        approach[k] = (registry.step(kind) + fastest) * 3 / 2 + 1;
+        reach[k] = far;
+        widest = std::max(widest, far);
+    }
+
+    // Полям направлений далёкая жертва тоже нужна - там спят только виды без жертв и угроз
+    if (flow_mode) {
+        presence.clear();
+        return;
+    }
+    int64_t cell = 2 * widest;
+    size_t cell_limit = world_.size() * PRESENCE_CELLS_PER_NPC + 16;
+    while (static_cast<size_t>((max_x_ + cell - 1) / cell) * static_cast<size_t>((max_y_ + cell - 1) / cell) > cell_limit) {
+        cell *= 2;
+    }
+    presence_cell = static_cast<int>(cell);
+    presence_cols = static_cast<int>((max_x_ + cell - 1) / cell);
+    presence_rows = static_cast<int>((max_y_ + cell - 1) / cell);
+    presence.assign(static_cast<size_t>(presence_cols) * presence_rows, 0);
+    std::span<const PackedNpc> hot = world_.hot_view();
+    for (size_t i = 0; i < hot.size(); ++i) {
+        if (world_.alive_at(i)) {
+            int cx = std::clamp(hot[i].x / presence_cell, 0, presence_cols - 1);
+            int cy = std::clamp(hot[i].y / presence_cell, 0, presence_rows - 1);
+            presence[static_cast<size_t>(cy) * presence_cols + cx] |= uint64_t{1} << hot[i].kind;
+        }
+    }
+}
+
+MemoryReport Simulation::memory_report() const {
+    MemoryReport report = world_.memory_report();
+    report.coroutine_bytes = scheduler.frame_pool().bytes();
+    report.scheduler_bytes = scheduler.memory_bytes();
+    return report;
+}
+
+bool Simulation::has_counterparts(int kind) const {
+    uint64_t mask = kind < static_cast<int>(counterparts.size()) ? counterparts[kind] : 0;
+    for (; mask; mask &= mask - 1) {
+        if (world_.population(std::countr_zero(mask)) > 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+uint32_t Simulation::idle_ticks(int x, int y, int kind) const {
+    if (presence.empty() || kind >= static_cast<int>(counterparts.size())) {
+        return 0;
+    }
+    uint64_t mask = counterparts[kind];
+    int cx = std::clamp(x / presence_cell, 0, presence_cols - 1);
+    int cy = std::clamp(y / presence_cell, 0, presence_rows - 1);
+    // Кольца клеток вокруг NPC до первого, где есть его жертвы или угрозы (сам NPC в маску
+    // попадает, только если вид опасен сам себе - тогда он не спит). Кольца дальше, чем нужно
+    // для MAX_IDLE_TICKS, и кольца целиком за краем мира не смотрим
+    int64_t budget = reach[kind] + static_cast<int64_t>(MAX_IDLE_TICKS) * approach[kind];
+    int rings = static_cast<int>(std::min<int64_t>(budget / presence_cell + 1,
+        std::max({cx, presence_cols - 1 - cx, cy, presence_rows - 1 - cy}) + 1));
+    auto occupied = [&](int col, int row) {
+        return col >= 0 && col < presence_cols && row >= 0 && row < presence_rows
+            && (presence[static_cast<size_t>(row) * presence_cols + col] & mask);
+    };
+    int r = 0;
+    for (bool found = false; r < rings; ++r) {
+        for (int col = cx - r; col <= cx + r && !found; ++col) {
+            found = occupied(col, cy - r) || occupied(col, cy + r);
+        }
+        for (int row = cy - r + 1; row < cy + r && !found; ++row) {
+            found = occupied(cx - r, row) || occupied(cx + r, row);
+        }
+        if (found) {
+            break;
+        }
+    }
+    if (r >= rings) {
+        return MAX_IDLE_TICKS;
+    }
+    // Кольца 0..r-1 пусты: до ближайшего не меньше (r - 1) клеток
+    int64_t clear = static_cast<int64_t>(r - 1) * presence_cell - reach[kind];
+    return clear <= 0 ? 0 : static_cast<uint32_t>(std::min<int64_t>(clear / approach[kind], MAX_IDLE_TICKS));
+}
+
+size_t Simulation::resolve(const std::vector<FightEvent> &events) {
+    std::lock_guard<std::mutex> fight_lock(fight_mtx);
+    return resolve_locked(events);
+}
+
+size_t Simulation::resolve(FightManager &queue, std::vector<FightEvent> &batch) {
+    std::lock_guard<std::mutex> fight_lock(fight_mtx);
+    queue.take(batch);
+    return resolve_locked(batch);
+}
+
+size_t Simulation::resolve_locked(const std::vector<FightEvent> &events) {
+    auto lock = world_.read_lock();
+    size_t kills = 0;
+    bool summary = print_kills && summarize_kills;
+    if (summary) {
+        tally.reset(registry);
+    }
+    for (auto &ev : events) {
+        // Проигранный бросок ничего не меняет - такие пары даже не ищем в мире.
+        // Право на атаку уже проверено матрицей видов при поиске пар
+        if (ev.attack <= ev.defense) {
+            continue;
+        }
+        const NPC_ptr &att = world_.shared(ev.attacker);
+        const NPC_ptr &def = world_.shared(ev.defender);
+        if (!att || !def || !att->is_alive() || !def->is_alive()) {
+            continue;
+        }
+        if (summary) {
+            ++tally.kills;
+            ++tally.by_kind[def->kind()];
+        } else if (print_kills) {
+            console_log().submit(LogRecord{LogRecord::Kill, att.get(), def.get(), tick_count, ev.attack, ev.defense});
+        }
+        def->must_die();
+        att->fight_notify(def, true);
+        ++kills;
+    }
+    if (summary && kills > 0) {
+        LogRecord record{LogRecord::Summary};
+        record.tick = tick_count;
+        record.tally = &tally;
+        console_log().submit(record);
+    }
+    if (trace && !events.empty()) {
+        trace->resolves.push_back({tick_count, static_cast<uint32_t>(events.size()), static_cast<uint32_t>(kills)});
+    }
+    return kills;
+}
+
+size_t Simulation::tick() {
+    // Пары из снимка разбираются до следующего перемещения, как их разобрал бы поток сражений
+    size_t kills = 0;
+    if (!restored_fights.empty()) {
+        kills = resolve(restored_fights);
+        restored_fights.clear();
+    }
+    pending.clear();
+    move_tick(pending);
+    return kills + resolve(pending);
+}
+
+void Simulation::capture(WorldSnapshot &snapshot, const FightManager *queue) const {
+    snapshot.clear();
+    // Таблица видов во время игры не меняется - её строки копируются до замков
+    registry.save_table(snapshot.kind_table, snapshot.kind_prey);
+
+    std::lock_guard<std::mutex> fight_lock(fight_mtx);
+    auto lock = world_.read_lock();
+    snapshot.tick = tick_count;
+    snapshot.max_x = max_x_;
+    snapshot.max_y = max_y_;
+    std::ostringstream rng_state;
+    rng_state << move_rng;
+    snapshot.move_rng = rng_state.str();
+    snapshot.dice_seed = dice.seed_value();
+
+    for (size_t i = 0; i < world_.size(); ++i) {
+        const PackedNpc &hot = world_.hot_at(i);
+        const NPC *npc = world_.at(i);
+        snapshot.kinds.push_back(hot.kind);
+        snapshot.alive.push_back(world_.alive_at(i));
+        snapshot.xs.push_back(hot.x);
+        snapshot.ys.push_back(hot.y);
+        snapshot.serials.push_back(npc->serial);
+        if (!npc->name.empty()) {
+            snapshot.named.emplace_back(static_cast<uint32_t>(i), world_.shared_at(i));
+        }
+    }
+
+    std::vector<Scheduler::Wakeup> wakeups;
+    scheduler.pending(wakeups);
+    for (auto &w : wakeups) {
+        size_t index = world_.index_of(unpack(w.tag));
+        if (index != SIZE_MAX) {
+            snapshot.wake_order.push_back(static_cast<uint32_t>(index));
+            snapshot.wake_delay.push_back(static_cast<uint32_t>(w.delay));
+        }
+    }
+
+    // Пары, которые поток сражений ещё не разобрал: под fight_mtx он не может держать их у себя
+    std::vector<FightEvent> queued(restored_fights);
+    if (queue) {
+        queue->queued(queued);
+    }
+    for (auto &ev : queued) {
+        size_t attacker = world_.index_of(ev.attacker);
+        size_t defender = world_.index_of(ev.defender);
+        if (attacker != SIZE_MAX && defender != SIZE_MAX) {
+            snapshot.fights.push_back(SnapshotFight{static_cast<uint32_t>(attacker), static_cast<uint32_t>(defender),
+                                                    ev.attack, ev.defense});
+        }
+    }
+}
+
+std::unique_ptr<Simulation> Simulation::restore(const WorldSnapshot &snapshot, const KindRegistry &registry) {
+    if (!registry.same_table(snapshot.kind_table, snapshot.kind_prey)) {
+        std::cerr << "Checkpoint was saved with a different kinds table\n";
+        return nullptr;
+    }
+    auto sim = std::make_unique<Simulation>(snapshot.max_x, snapshot.max_y, 0, registry);
+    std::istringstream move_state(snapshot.move_rng);
+    if (!(move_state >> sim->move_rng)) {
+        std::cerr << "Invalid RNG state in checkpoint\n";
+        return nullptr;
+    }
+    sim->dice = CounterDice(snapshot.dice_seed);
+    sim->tick_count = snapshot.tick;
+
+    std::vector<EntityId> ids(snapshot.size());
+    for (size_t i = 0; i < snapshot.size(); ++i) {
+        auto npc = factory(static_cast<NpcKind>(snapshot.kinds[i]), std::string(snapshot.name(i)),
+                           snapshot.xs[i], snapshot.ys[i]);
+        if (!npc) {
+            std::cerr << "Unknown NPC type in checkpoint: " << int(snapshot.kinds[i]) << "\n";
+            return nullptr;
+        }
+        npc->serial = snapshot.serials[i];
+        if (!snapshot.alive[i]) {
+            npc->must_die();
+        }
+        ids[i] = sim->world_.spawn(npc);
+    }
+    FramePool::Scope frames(sim->scheduler.frame_pool());
+    for (size_t w = 0; w < snapshot.wake_order.size(); ++w) {
+        uint32_t index = snapshot.wake_order[w];
+        EntityId id = ids[index];
+        sim->scheduler.spawn(wander(*sim, id, snapshot.kinds[index], sim->move_rng), pack(id), snapshot.wake_delay[w]);
+    }
+    for (auto &fight : snapshot.fights) {
+        sim->restored_fights.push_back(FightEvent{ids[fight.attacker], ids[fight.defender], fight.attack, fight.defense});
+    }
+    return sim;
+}
+
+void Simulation::take_restored_fights(std::vector<FightEvent> &out) {
+    out.insert(out.end(), restored_fights.begin(), restored_fights.end());
+    restored_fights.clear();
+}
+
+void Simulation::record(FightTrace *trace_) {
+    if (trace_) {
+        capture(trace_->start);
+        trace_->flow = flow_mode;
+        trace_->end_tick = tick_count;
+        trace_->resolves.clear();
+    } else if (trace) {
+        trace->end_tick = tick_count;
+    }
+    trace = trace_;
+}
+
+void FightManager::add_events(std::vector<FightEvent> &batch) {
+    std::lock_guard<std::mutex> l(mtx);
+    events.insert(events.end(), batch.begin(), batch.end());
+    batch.clear();
+}
+
+void FightManager::take(std::vector<FightEvent> &batch) {
+    std::lock_guard<std::mutex> l(mtx);
+    batch.swap(events);
+}
+
+void FightManager::queued(std::vector<FightEvent> &out) const {
+    std::lock_guard<std::mutex> l(mtx);
+    out.insert(out.end(), events.begin(), events.end());
+}
+
+void FightManager::operator()() {
+    std::vector<FightEvent> batch;
+    pace.start();
+    while (true) {
+        bool stopping = !running;
+        sim.resolve(*this, batch);
+        if (batch.empty() && stopping) {
+            break;
+        }
+        batch.clear();
+        pace.wait();
+    }
+}
@@ -0,0 +1,219 @@
+#include "spatial_index.h"
+#include <algorithm>
+
+namespace {
+    // Сетка не больше чем в несколько раз крупнее числа NPC, иначе разреженный мир съест память
+    constexpr size_t CELLS_PER_NPC = 4;
+}
+
+void SpatialIndex::rebuild(const World &world, int cell_size) {
+    // Три прохода по плотному массиву мира без промежуточных копий: рамка и число живых,
+    // подсчёт по клеткам, раскладка
+    std::span<const PackedNpc> hot = world.hot_view();
+    size_t count = 0;
+    present = 0;
+    int min_x = 0, min_y = 0, max_x = 0, max_y = 0;
+    for (size_t i = 0; i < hot.size(); ++i) {
+        if (!world.alive_at(i)) {
+            continue;
+        }
+        const PackedNpc &npc = hot[i];
+        if (count++ == 0) {
+            min_x = max_x = npc.x;
+            min_y = max_y = npc.y;
+        }
+        min_x = std::min(min_x, npc.x);
+        max_x = std::max(max_x, npc.x);
+        min_y = std::min(min_y, npc.y);
+        max_y = std::max(max_y, npc.y);
+        present |= uint64_t{1} << npc.kind;
+    }
+
+    if (cell_size <= 0) {
+        cell_size = 1;
+        for (size_t k = 1; k < registry.size(); ++k) {
+            cell_size = std::max(cell_size, registry.kill_radius(static_cast<int>(k)));
+        }
+    }
+    cell = cell_size;
+    origin_x = min_x;
+    origin_y = min_y;
+    int64_t width = static_cast<int64_t>(max_x) - min_x + 1;
+    int64_t height = static_cast<int64_t>(max_y) - min_y + 1;
+    size_t cell_limit = count * CELLS_PER_NPC + 16;
+    while (static_cast<size_t>((width + cell - 1) / cell) * static_cast<size_t>((height + cell - 1) / cell) > cell_limit) {
+        cell = cell > std::numeric_limits<int>::max() / 2 ? std::numeric_limits<int>::max() : cell * 2;
+    }
+    cols = static_cast<int>((width + cell - 1) / cell);
+    rows = static_cast<int>((height + cell - 1) / cell);
+
+    // Сортировка подсчётом по клеткам. Внутри рамки смещения неотрицательны и меньше 2^32:
+    // беззнаковое 32-битное деление вместо 64-битного с ограничением по краям, как в запросах
+    size_t cell_count = static_cast<size_t>(cols) * rows;
+    cell_start.assign(cell_count + 1, 0);
+    cell_of.resize(hot.size());
+    for (size_t i = 0; i < hot.size(); ++i) {
+        if (!world.alive_at(i)) {
+            continue;
+        }
+        const PackedNpc &npc = hot[i];
+        uint32_t cx = static_cast<uint32_t>(static_cast<int64_t>(npc.x) - min_x) / static_cast<uint32_t>(cell);
+        uint32_t cy = static_cast<uint32_t>(static_cast<int64_t>(npc.y) - min_y) / static_cast<uint32_t>(cell);
+        cell_of[i] = cy * static_cast<uint32_t>(cols) + cx;
+        ++cell_start[cell_of[i]];
+    }
+    // После сумм cell_start[c] - конец клетки c. Раскладка с конца ставит запись перед ним, и после
+    // прохода cell_start[c] - начало клетки c, а порядок плотных индексов внутри клетки сохраняется
+    for (size_t c = 1; c < cell_count; ++c) {
+        cell_start[c] += cell_start[c - 1];
+    }
+    cell_start[cell_count] = static_cast<uint32_t>(count);
+
+    xs.resize(count);
+    ys.resize(count);
+    ids.resize(count);
+    kind_of.resize(count);
+    for (size_t i = hot.size(); i-- > 0;) {
+        if (!world.alive_at(i)) {
+            continue;
+        }
+        const PackedNpc &npc = hot[i];
+        uint32_t pos = --cell_start[cell_of[i]];
+        xs[pos] = npc.x;
+        ys[pos] = npc.y;
+        ids[pos] = static_cast<uint32_t>(i);
+        kind_of[pos] = npc.kind;
+    }
+}
+
+int SpatialIndex::cell_x(int x) const {
+    int64_t c = (static_cast<int64_t>(x) - origin_x) / cell;
+    return static_cast<int>(std::clamp<int64_t>(c, 0, cols - 1));
+}
+
+int SpatialIndex::cell_y(int y) const {
+    int64_t c = (static_cast<int64_t>(y) - origin_y) / cell;
+    return static_cast<int>(std::clamp<int64_t>(c, 0, rows - 1));
+}
+
+template <typename Visit>
+void SpatialIndex::scan(int cx0, int cy0, int cx1, int cy1, uint64_t kinds, Visit &&visit) const {
+    for (int cy = cy0; cy <= cy1; ++cy) {
+        size_t row = static_cast<size_t>(cy) * cols;
+        // Клетки одной строки сетки лежат подряд - обходим их одним диапазоном
+        for (uint32_t e = cell_start[row + cx0], end = cell_start[row + cx1 + 1]; e < end; ++e) {
+            if (kinds >> kind_of[e] & 1) {
+                visit(e);
+            }
+        }
+    }
+}
+
+void SpatialIndex::radius(int x, int y, int64_t radius, std::vector<uint32_t> &out, uint64_t kinds, uint32_t exclude) const {
+    if (xs.empty() || radius < 0) {
+        return;
+    }
+    radius = std::min<int64_t>(radius, std::numeric_limits<int32_t>::max());
+    int64_t x0 = static_cast<int64_t>(x) - radius, x1 = static_cast<int64_t>(x) + radius;
+    int64_t y0 = static_cast<int64_t>(y) - radius, y1 = static_cast<int64_t>(y) + radius;
+    if (x1 < origin_x || y1 < origin_y
+        || x0 >= origin_x + static_cast<int64_t>(cols) * cell || y0 >= origin_y + static_cast<int64_t>(rows) * cell) {
+        return;
+    }
+    int64_t r_sq = radius * radius;
+    scan(cell_x(static_cast<int>(std::max<int64_t>(x0, origin_x))), cell_y(static_cast<int>(std::max<int64_t>(y0, origin_y))),
+         cell_x(static_cast<int>(std::min<int64_t>(x1, std::numeric_limits<int>::max()))),
+         cell_y(static_cast<int>(std::min<int64_t>(y1, std::numeric_limits<int>::max()))),
+         kinds, [&](uint32_t e) {
+        int64_t dx = static_cast<int64_t>(xs[e]) - x;
+        int64_t dy = static_cast<int64_t>(ys[e]) - y;
+        if (dx * dx + dy * dy <= r_sq && ids[e] != exclude) {
+            out.push_back(ids[e]);
+        }
+    });
+}
+
+void SpatialIndex::rect(int x0, int y0, int x1, int y1, std::vector<uint32_t> &out, uint64_t kinds) const {
+    if (xs.empty() || x0 > x1 || y0 > y1) {
+        return;
+    }
+    if (x1 < origin_x || y1 < origin_y
+        || x0 >= origin_x + static_cast<int64_t>(cols) * cell || y0 >= origin_y + static_cast<int64_t>(rows) * cell) {
+        return;
+    }
+    scan(cell_x(x0), cell_y(y0), cell_x(x1), cell_y(y1), kinds, [&](uint32_t e) {
+        if (xs[e] >= x0 && xs[e] <= x1 && ys[e] >= y0 && ys[e] <= y1) {
+            out.push_back(ids[e]);
+        }
+    });
+}
+
+void SpatialIndex::nearest(int x, int y, size_t k, std::vector<uint32_t> &out, uint64_t kinds,
+                           uint32_t exclude, int64_t max_radius) const {
+    // Без этой проверки поиск вида, которого нет в мире, обошёл бы всю сетку
+    kinds &= present;
+    if (xs.empty() || k == 0 || max_radius < 0 || !kinds) {
+        return;
+    }
+    max_radius = std::min<int64_t>(max_radius, std::numeric_limits<int32_t>::max());
+    int64_t max_sq = max_radius * max_radius;
+
+    // Кандидаты - max-куча по (расстояние, индекс) размером не больше k
+    using Candidate = std::pair<int64_t, uint32_t>;
+    std::vector<Candidate> best;
+    best.reserve(k + 1);
+    auto consider = [&](uint32_t e) {
+        if (ids[e] == exclude) {
+            return;
+        }
+        int64_t dx = static_cast<int64_t>(xs[e]) - x;
+        int64_t dy = static_cast<int64_t>(ys[e]) - y;
+        Candidate c{dx * dx + dy * dy, ids[e]};
+        if (c.first > max_sq || (best.size() == k && !(c < best.front()))) {
+            return;
+        }
+        best.push_back(c);
+        std::push_heap(best.begin(), best.end());
+        if (best.size() > k) {
+            std::pop_heap(best.begin(), best.end());
+            best.pop_back();
+        }
+    };
+
+    // Обход колец клеток вокруг клетки запроса. После кольца r все непросмотренные
+    // дальше r * cell, поэтому поиск заканчивается, как только k-й кандидат ближе этой границы.
+    int cx = cell_x(x), cy = cell_y(y);
+    int last_ring = std::max({cx, cols - 1 - cx, cy, rows - 1 - cy});
+    for (int r = 0; r <= last_ring; ++r) {
+        int x0 = cx - r, x1 = cx + r, y0 = cy - r, y1 = cy + r;
+        int sx0 = std::max(x0, 0), sx1 = std::min(x1, cols - 1);
+        if (y0 >= 0) {
+            scan(sx0, y0, sx1, y0, kinds, consider);
+        }
+        if (r > 0 && y1 < rows) {
+            scan(sx0, y1, sx1, y1, kinds, consider);
+        }
+        for (int row = std::max(y0 + 1, 0); r > 0 && row <= std::min(y1 - 1, rows - 1); ++row) {
+            if (x0 >= 0) {
+                scan(x0, row, x0, row, kinds, consider);
+            }
+            if (x1 < cols) {
+                scan(x1, row, x1, row, kinds, consider);
+            }
+        }
+        int64_t reach = static_cast<int64_t>(r) * cell;
+        if (reach * reach >= max_sq || (best.size() == k && best.front().first <= reach * reach)) {
+            break;
+        }
+    }
+
+    std::sort_heap(best.begin(), best.end());
+    for (auto &c : best) {
+        out.push_back(c.second);
+    }
+}
+
+void SpatialIndex::nearest_prey(const World &world, size_t i, size_t k, std::vector<uint32_t> &out) const {
+    const PackedNpc &npc = world.hot_at(i);
+    nearest(npc.x, npc.y, k, out, prey_mask(npc.kind), static_cast<uint32_t>(i));
+}
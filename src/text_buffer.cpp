@@ -0,0 +1,6 @@
+#include "text_buffer.h"
+
+TextBuffer &TextBuffer::local() {
+    thread_local TextBuffer buffer;
+    return buffer;
+}
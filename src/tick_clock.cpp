@@ -0,0 +1,73 @@
+#include "tick_clock.h"
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+#include <thread>
+
+TickClock::TickClock(double rate_hz) {
+    set_rate(rate_hz);
+}
+
+void TickClock::set_rate(double rate_hz) {
+    rate_hz = std::max(rate_hz, 1e-3);
+    period = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / rate_hz));
+    period = std::max(period, Clock::duration(1));
+}
+
+void TickClock::start() {
+    tick_start = Clock::now();
+    deadline = tick_start + period;
+    started = true;
+}
+
+bool TickClock::wait() {
+    auto now = Clock::now();
+    if (!started) {
+        start();
+        return true;
+    }
+    double work_ms = std::chrono::duration<double, std::milli>(now - tick_start).count();
+    bool on_time = now <= deadline;
+    uint64_t skipped = 0;
+    if (on_time) {
+        std::this_thread::sleep_until(deadline);
+    } else if (now - deadline >= period) {
+        // Отстали больше чем на тик: не догоняем, следующий дедлайн - от текущего момента
+        skipped = static_cast<uint64_t>((now - deadline) / period);
+        deadline = now;
+    }
+
+    auto woke = Clock::now();
+    double jitter_ms = std::chrono::duration<double, std::milli>(woke - deadline).count();
+    tick_start = woke;
+    deadline += period;
+    behind.store(!on_time, std::memory_order_relaxed);
+
+    std::lock_guard<std::mutex> l(mtx);
+    ++counters.ticks;
+    counters.overruns += !on_time;
+    counters.skipped += skipped;
+    counters.work_ms_total += work_ms;
+    counters.work_ms_max = std::max(counters.work_ms_max, work_ms);
+    counters.jitter_ms_total += jitter_ms;
+    counters.jitter_ms_max = std::max(counters.jitter_ms_max, jitter_ms);
+    return on_time;
+}
+
+TickClock::Stats TickClock::stats() const {
+    std::lock_guard<std::mutex> l(mtx);
+    return counters;
+}
+
+std::ostream &operator<<(std::ostream &os, const TickClock::Stats &stats) {
+    double ticks = stats.ticks ? static_cast<double>(stats.ticks) : 1.0;
+    auto flags = os.flags();
+    auto precision = os.precision();
+    os << std::fixed << std::setprecision(3)
+       << stats.ticks << " ticks, " << stats.overruns << " overruns, " << stats.skipped << " skipped; "
+       << "work avg " << stats.work_ms_total / ticks << " ms, max " << stats.work_ms_max << " ms; "
+       << "jitter avg " << stats.jitter_ms_total / ticks << " ms, max " << stats.jitter_ms_max << " ms";
+    os.flags(flags);
+    os.precision(precision);
+    return os;
+}
@@ -1,9 +1,13 @@
 #include "toad.h"
 #include "factory.h"
+#include "creature.h"
+#include "kind_registry.h"
 
-Toad::Toad(const std::string &name_, int x_, int y_) : NPC(name_, x_, y_) {}
+Toad::Toad() : NPC(ToadType) {}
 
-Toad::Toad(std::istream &is){
+Toad::Toad(const std::string &name_, int x_, int y_) : NPC(ToadType, name_, x_, y_) {}
+
+Toad::Toad(std::istream &is) : NPC(ToadType) {
     is >> name;
     is >> x >> y;
 }
@@ -12,11 +16,15 @@ bool Toad::accept(const NPC_ptr &attacker) {
     return attacker->visit_toad(std::static_pointer_cast<Toad>(shared_from_this()));
 }
 
-bool Toad::visit_dragon(const std::shared_ptr<Dragon> &defender){return false; }
-bool Toad::visit_bull(const std::shared_ptr<Bull> &defender){return false;}
-bool Toad::visit_toad(const std::shared_ptr<Toad> &defender){return false;}
+bool Toad::visit_dragon(const std::shared_ptr<Dragon> &){return KindRegistry::instance().can_kill(ToadType, DragonType);}
+bool Toad::visit_bull(const std::shared_ptr<Bull> &){return KindRegistry::instance().can_kill(ToadType, BullType);}
+bool Toad::visit_toad(const std::shared_ptr<Toad> &){return KindRegistry::instance().can_kill(ToadType, ToadType);}
+bool Toad::visit_creature(const std::shared_ptr<Creature> &defender){return KindRegistry::instance().can_kill(ToadType, defender->kind());}
+
+int Toad::step() const {return KindRegistry::instance().step(ToadType);}
+int Toad::kill_radius() const {return KindRegistry::instance().kill_radius(ToadType);}
 
-void Toad::print() const {std::cout << "Toad: " << *this << std::endl; }
+void Toad::describe(TextBuffer &out) const {describe_as(out, "Toad");}
 
 void Toad::save(std::ostream &os) const {
     os << ToadType << std::endl;
@@ -1,59 +1,185 @@
 #include "visitor.h"
+#include "event_log.h"
 #include <iostream>
 #include <algorithm>
 #include <random>
 #include <chrono>
+#include <thread>
+#include <barrier>
 
-void BattleManager::battle(std::vector<std::shared_ptr<NPC>>& npcs, size_t distance) {
-    std::cout << "=== Starting battle (attack range: " << distance << ") ===" << std::endl;
+namespace {
+    using Pair = std::pair<uint32_t, uint32_t>;
 
-    unsigned seed = std::chrono::system_clock::now().time_since_epoch().count();
-    std::shuffle(npcs.begin(), npcs.end(), std::default_random_engine(seed));
-    
-    std::vector<std::shared_ptr<NPC>> dead_npcs;
+    unsigned worker_count(unsigned threads) {
+        if (threads == 0) {
+            threads = std::max(1u, std::thread::hardware_concurrency());
+        }
+        return threads;
+    }
+
+    void shuffle_npcs(std::vector<std::shared_ptr<NPC>>& npcs) {
+        unsigned seed = std::chrono::system_clock::now().time_since_epoch().count();
+        std::shuffle(npcs.begin(), npcs.end(), std::default_random_engine(seed));
+    }
+
+    void remove_dead(std::vector<std::shared_ptr<NPC>>& npcs, const std::vector<bool>& dead) {
+        size_t out = 0;
+        for (size_t i = 0; i < npcs.size(); ++i) {
+            if (!dead[i]) {
+                npcs[out++] = std::move(npcs[i]);
+            }
+        }
+        npcs.resize(out);
+    }
+
+    // Все пары i < j в радиусе в том же порядке, в котором их обходит последовательный алгоритм
+    std::vector<Pair> close_pairs(const std::vector<std::shared_ptr<NPC>>& npcs, size_t distance, unsigned threads) {
+        size_t n = npcs.size();
+        std::vector<std::vector<Pair>> parts(threads);
+        std::vector<std::thread> workers;
+        for (unsigned t = 0; t < threads; ++t) {
+            workers.emplace_back([&, t]() {
+                // Строки раздаются через одну, чтобы треугольник i < j делился поровну
+                for (size_t i = t; i < n; i += threads) {
+                    for (size_t j = i + 1; j < n; ++j) {
+                        if (npcs[i]->is_close(npcs[j], distance)) {
+                            parts[t].emplace_back(static_cast<uint32_t>(i), static_cast<uint32_t>(j));
+                        }
+                    }
+                }
+            });
+        }
+        for (auto &w : workers) {
+            w.join();
+        }
+
+        std::vector<Pair> pairs;
+        for (auto &part : parts) {
+            pairs.insert(pairs.end(), part.begin(), part.end());
+        }
+        std::sort(pairs.begin(), pairs.end());
+        return pairs;
+    }
+}
+
+void BattleManager::process_fight(const std::shared_ptr<NPC> &first, const std::shared_ptr<NPC> &second,
+                                  uint8_t &first_dead, uint8_t &second_dead, bool verbose) {
+    if (verbose) {
+        console_log().submit(LogRecord{LogRecord::Battle, first.get(), second.get(), 0, 0, 0, LogLevel::Debug});
+    }
+
+    if (second->accept(first)) {
+        second_dead = 1;
+        if (verbose) {
+            console_log().submit(LogRecord{LogRecord::Kill, first.get(), second.get()});
+        }
+    }
+
+    if (!first_dead && first->accept(second)) {
+        first_dead = 1;
+        if (verbose) {
+            console_log().submit(LogRecord{LogRecord::Kill, second.get(), first.get()});
+        }
+    }
+}
+
+std::vector<bool> BattleManager::resolve(const std::vector<std::shared_ptr<NPC>>& npcs, size_t distance, bool verbose) {
+    std::vector<uint8_t> dead(npcs.size(), 0);
 
     for (size_t i = 0; i < npcs.size(); ++i) {
-        if (std::find(dead_npcs.begin(), dead_npcs.end(), npcs[i]) != dead_npcs.end()) {
+        if (dead[i]) {
             continue;
         }
-        
-        for (size_t j = i + 1; j < npcs.size(); ++j) {
-            if (std::find(dead_npcs.begin(), dead_npcs.end(), npcs[j]) != dead_npcs.end()) {
+        for (size_t j = i + 1; j < npcs.size() && !dead[i]; ++j) {
+            if (dead[j]) {
                 continue;
             }
-
             if (npcs[i]->is_close(npcs[j], distance)) {
-                std::cout << "\nBattle between: " << std::endl;
-                npcs[i]->print();
-                npcs[j]->print();
-
-                bool first_kills_second = npcs[j]->accept(npcs[i]);
-                if (first_kills_second) {
-                    dead_npcs.push_back(npcs[j]);
-                    std::cout << npcs[i]->name << " killed " << npcs[j]->name << std::endl;
-                }
+                process_fight(npcs[i], npcs[j], dead[i], dead[j], verbose);
+            }
+        }
+    }
+    return std::vector<bool>(dead.begin(), dead.end());
+}
+
+// Пары раскладываются по уровням: уровень пары на единицу больше последнего уровня,
+// в котором уже участвовал любой из её NPC. Внутри уровня ни один NPC не встречается дважды,
+// а все более ранние (в последовательном порядке) пары с теми же NPC лежат ниже,
+// поэтому уровни можно разбирать параллельно с тем же результатом, что и resolve().
+std::vector<bool> BattleManager::resolve_parallel(const std::vector<std::shared_ptr<NPC>>& npcs, size_t distance, unsigned threads) {
+    threads = worker_count(threads);
+    std::vector<Pair> pairs = close_pairs(npcs, distance, threads);
+
+    std::vector<uint32_t> last_level(npcs.size(), 0);
+    std::vector<uint32_t> level_of(pairs.size());
+    uint32_t levels = 0;
+    for (size_t p = 0; p < pairs.size(); ++p) {
+        auto [i, j] = pairs[p];
+        uint32_t level = std::max(last_level[i], last_level[j]) + 1;
+        last_level[i] = last_level[j] = level;
+        level_of[p] = level - 1;
+        levels = std::max(levels, level);
+    }
+
+    std::vector<size_t> level_begin(levels + 1, 0);
+    for (uint32_t level : level_of) {
+        ++level_begin[level + 1];
+    }
+    for (uint32_t l = 0; l < levels; ++l) {
+        level_begin[l + 1] += level_begin[l];
+    }
+    std::vector<Pair> ordered(pairs.size());
+    std::vector<size_t> cursor(level_begin.begin(), level_begin.end() - 1);
+    for (size_t p = 0; p < pairs.size(); ++p) {
+        ordered[cursor[level_of[p]]++] = pairs[p];
+    }
 
-                if (std::find(dead_npcs.begin(), dead_npcs.end(), npcs[i]) == dead_npcs.end()) {
-                    bool second_kills_first = npcs[i]->accept(npcs[j]);
-                    if (second_kills_first) {
-                        dead_npcs.push_back(npcs[i]);
-                        std::cout << npcs[j]->name << " killed " << npcs[i]->name << std::endl;
-                        break;
+    std::vector<uint8_t> dead(npcs.size(), 0);
+    std::barrier sync(static_cast<std::ptrdiff_t>(threads));
+    std::vector<std::thread> workers;
+    for (unsigned t = 0; t < threads; ++t) {
+        workers.emplace_back([&, t]() {
+            for (uint32_t l = 0; l < levels; ++l) {
+                size_t begin = level_begin[l];
+                size_t count = level_begin[l + 1] - begin;
+                for (size_t p = begin + count * t / threads; p < begin + count * (t + 1) / threads; ++p) {
+                    auto [i, j] = ordered[p];
+                    if (!dead[i] && !dead[j]) {
+                        process_fight(npcs[i], npcs[j], dead[i], dead[j], false);
                     }
                 }
+                sync.arrive_and_wait();
             }
-        }
+        });
     }
+    for (auto &w : workers) {
+        w.join();
+    }
+    return std::vector<bool>(dead.begin(), dead.end());
+}
+
+void BattleManager::battle(std::vector<std::shared_ptr<NPC>>& npcs, size_t distance) {
+    std::cout << "=== Starting battle (attack range: " << distance << ") ===" << std::endl;
+
+    shuffle_npcs(npcs);
+    std::vector<bool> dead = resolve(npcs, distance, true);
+    size_t killed = std::count(dead.begin(), dead.end(), true);
+    remove_dead(npcs, dead);
 
-    npcs.erase(
-        std::remove_if(npcs.begin(), npcs.end(),
-            [&dead_npcs](const std::shared_ptr<NPC>& npc) {
-                return std::find(dead_npcs.begin(), dead_npcs.end(), npc) != dead_npcs.end();
-            }),
-        npcs.end()
-    );
-    
     std::cout << "\n=== Battle finished ===" << std::endl;
     std::cout << "Survivors: " << npcs.size() << std::endl;
-    std::cout << "Killed: " << dead_npcs.size() << std::endl;
-}
\ No newline at end of file
+    std::cout << "Killed: " << killed << std::endl;
+}
+
+void BattleManager::mass_battle(std::vector<std::shared_ptr<NPC>>& npcs, size_t distance, unsigned threads) {
+    std::cout << "=== Starting mass battle (attack range: " << distance << ") ===" << std::endl;
+
+    shuffle_npcs(npcs);
+    std::vector<bool> dead = resolve_parallel(npcs, distance, threads);
+    size_t killed = std::count(dead.begin(), dead.end(), true);
+    remove_dead(npcs, dead);
+
+    std::cout << "\n=== Mass battle finished ===" << std::endl;
+    std::cout << "Survivors: " << npcs.size() << std::endl;
+    std::cout << "Killed: " << killed << std::endl;
+}
@@ -0,0 +1,181 @@
+#include "world.h"
+#include <fstream>
+#include <iomanip>
+#include <unistd.h>
+
+World::~World() {
+    // NPC могут пережить мир через shared_ptr - отвязываем их от счётчиков
+    for (auto &npc : npcs) {
+        npc->track(nullptr);
+        npc->bind(nullptr);
+    }
+}
+
+EntityId World::spawn(NPC_ptr npc) {
+    std::unique_lock lock(mtx);
+    return spawn_unlocked(std::move(npc));
+}
+
+void World::spawn(std::span<const NPC_ptr> batch, std::vector<EntityId> &ids) {
+    std::unique_lock lock(mtx);
+    size_t total = npcs.size() + batch.size();
+    npcs.reserve(total);
+    owners.reserve(total);
+    slots.reserve(slots.size() + (batch.size() > free_slots.size() ? batch.size() - free_slots.size() : 0));
+    if (hot.capacity() < total) {
+        hot.reserve(total);
+        for (size_t i = 0; i < npcs.size(); ++i) {
+            npcs[i]->bind(&hot[i]);
+        }
+    }
+    ids.reserve(ids.size() + batch.size());
+    for (const NPC_ptr &npc : batch) {
+        ids.push_back(spawn_unlocked(npc));
+    }
+}
+
+EntityId World::spawn_unlocked(NPC_ptr npc) {
+    npc->track(&counters);
+    uint32_t index;
+    if (!free_slots.empty()) {
+        index = free_slots.back();
+        free_slots.pop_back();
+    } else {
+        index = static_cast<uint32_t>(slots.size());
+        slots.emplace_back();
+    }
+    slots[index].dense = static_cast<uint32_t>(npcs.size());
+    npcs.push_back(std::move(npc));
+    size_t capacity = hot.capacity();
+    hot.emplace_back();
+    owners.push_back(index);
+    if (hot.capacity() != capacity) {
+        // Массив переехал - все NPC получают новые адреса своих записей
+        for (size_t i = 0; i < npcs.size(); ++i) {
+            npcs[i]->bind(&hot[i]);
+        }
+    } else {
+        npcs.back()->bind(&hot.back());
+    }
+    return {index, slots[index].generation};
+}
+
+void World::release(EntityId id) {
+    std::unique_lock lock(mtx);
+    if (contains(id)) {
+        release_unlocked(id.index);
+    }
+}
+
+size_t World::collect() {
+    std::unique_lock lock(mtx);
+    size_t released = 0;
+    for (size_t i = npcs.size(); i-- > 0;) {
+        if (!npcs[i]->is_alive()) {
+            release_unlocked(owners[i]);
+            ++released;
+        }
+    }
+    return released;
+}
+
+void World::reorder(std::span<const uint32_t> order) {
+    std::unique_lock lock(mtx);
+    if (order.size() != npcs.size()) {
+        return;
+    }
+    std::vector<NPC_ptr> moved(npcs.size());
+    std::vector<uint32_t> moved_owners(owners.size());
+    for (size_t i = 0; i < order.size(); ++i) {
+        moved[i] = std::move(npcs[order[i]]);
+        moved_owners[i] = owners[order[i]];
+    }
+    npcs.swap(moved);
+    owners.swap(moved_owners);
+    // Горячие записи заполняет bind() из самих NPC - переставлять их отдельно не нужно
+    for (size_t i = 0; i < npcs.size(); ++i) {
+        slots[owners[i]].dense = static_cast<uint32_t>(i);
+        npcs[i]->bind(&hot[i]);
+    }
+}
+
+void World::release_unlocked(uint32_t index) {
+    uint32_t dense = slots[index].dense;
+    npcs[dense]->track(nullptr);
+    npcs[dense]->bind(nullptr);
+    uint32_t last = static_cast<uint32_t>(npcs.size() - 1);
+    if (dense != last) {
+        npcs[dense] = std::move(npcs[last]);
+        npcs[dense]->bind(&hot[dense]);
+        owners[dense] = owners[last];
+        slots[owners[dense]].dense = dense;
+    }
+    npcs.pop_back();
+    hot.pop_back();
+    owners.pop_back();
+
+    Slot &slot = slots[index];
+    slot.dense = EntityId::invalid_index;
+    // Слот с исчерпанным счётчиком поколений больше не выдаём, чтобы старый id не ожил
+    if (++slot.generation != UINT32_MAX) {
+        free_slots.push_back(index);
+    }
+}
+
+bool World::contains(EntityId id) const {
+    return id.index < slots.size()
+        && slots[id.index].generation == id.generation
+        && slots[id.index].dense != EntityId::invalid_index;
+}
+
+NPC *World::get(EntityId id) const {
+    return contains(id) ? npcs[slots[id.index].dense].get() : nullptr;
+}
+
+const NPC_ptr &World::shared(EntityId id) const {
+    static const NPC_ptr empty;
+    return contains(id) ? npcs[slots[id.index].dense] : empty;
+}
+
+MemoryReport World::memory_report() const {
+    MemoryReport report;
+    report.npcs = npcs.size();
+    report.hot_bytes = hot.capacity() * sizeof(PackedNpc);
+    for (auto &npc : npcs) {
+        report.object_bytes += npc->footprint();
+    }
+    report.bookkeeping_bytes = slots.capacity() * sizeof(Slot) + free_slots.capacity() * sizeof(uint32_t)
+        + npcs.capacity() * sizeof(NPC_ptr) + owners.capacity() * sizeof(uint32_t);
+    report.resident_bytes = resident_bytes();
+    return report;
+}
+
+size_t resident_bytes() {
+    std::ifstream statm("/proc/self/statm");
+    size_t total_pages = 0, resident_pages = 0;
+    if (!(statm >> total_pages >> resident_pages)) {
+        return 0;
+    }
+    return resident_pages * static_cast<size_t>(sysconf(_SC_PAGESIZE));
+}
+
+std::ostream &operator<<(std::ostream &os, const MemoryReport &report) {
+    constexpr double MB = 1024.0 * 1024.0;
+    auto flags = os.flags();
+    auto precision = os.precision();
+    os << std::fixed << std::setprecision(1)
+       << "Memory: " << report.npcs << " NPCs, " << report.bytes_per_npc() << " B/NPC ("
+       << report.hot_per_npc() << " hot, "
+       << (report.npcs ? double(report.object_bytes) / report.npcs : 0.0) << " objects, "
+       << (report.npcs ? double(report.bookkeeping_bytes) / report.npcs : 0.0) << " bookkeeping";
+    if (report.coroutine_bytes || report.scheduler_bytes) {
+        os << ", " << (report.npcs ? double(report.coroutine_bytes) / report.npcs : 0.0) << " coroutine frames, "
+           << (report.npcs ? double(report.scheduler_bytes) / report.npcs : 0.0) << " scheduler";
+    }
+    os << ")\n"
+       << "  total " << report.total_bytes() / MB << " MB, resident " << report.resident_bytes / MB << " MB, "
+       << "projected for 10^7 NPCs " << report.projected_bytes(10000000) / MB << " MB";
+    os.flags(flags);
+    os.precision(precision);
+    return os;
+}
@@ -0,0 +1,73 @@
+#include "world_gen.h"
+#include <algorithm>
+#include <random>
+#include <thread>
+#include "factory.h"
+
+namespace {
+    constexpr size_t CHUNK = size_t{1} << 16;
+}
+
+size_t generate_world(Simulation &sim, const WorldSpec &spec) {
+    const KindRegistry &registry = sim.kinds();
+    // Накопленные веса видов: вид выбирается бинарным поиском по равномерному числу
+    std::vector<double> cumulative;
+    std::vector<int> kinds;
+    double sum = 0;
+    for (size_t k = 1; k < registry.size(); ++k) {
+        double w = spec.weights.empty() ? 1.0 : (k < spec.weights.size() ? spec.weights[k] : 0.0);
+        if (w > 0) {
+            sum += w;
+            cumulative.push_back(sum);
+            kinds.push_back(static_cast<int>(k));
+        }
+    }
+    if (spec.count == 0 || kinds.empty() || sim.max_x() <= 0 || sim.max_y() <= 0) {
+        return 0;
+    }
+
+    std::vector<NPC_ptr> npcs(spec.count);
+    size_t chunks = (spec.count + CHUNK - 1) / CHUNK;
+    auto fill = [&](size_t chunk) {
+        std::seed_seq seq{spec.seed, static_cast<uint32_t>(chunk), static_cast<uint32_t>(chunk >> 32)};
+        std::mt19937 rng(seq);
+        std::uniform_real_distribution<double> pick(0.0, sum);
+        std::uniform_int_distribution<int> coord_x(0, sim.max_x() - 1);
+        std::uniform_int_distribution<int> coord_y(0, sim.max_y() - 1);
+        // Своя арена у куска: потоки не делят блоки, а память куска уходит вместе с его последним NPC
+        NpcArena::Owner arena = NpcArena::make();
+        size_t end = std::min(spec.count, (chunk + 1) * CHUNK);
+        for (size_t i = chunk * CHUNK; i < end; ++i) {
+            size_t k = std::upper_bound(cumulative.begin(), cumulative.end(), pick(rng)) - cumulative.begin();
+            int kind = kinds[std::min(k, kinds.size() - 1)];
+            int x = coord_x(rng);
+            int y = coord_y(rng);
+            NPC_ptr npc = create(*arena, static_cast<NpcKind>(kind), std::string(), x, y);
+            npc->serial = static_cast<uint32_t>(i);
+            for (auto &observer : spec.observers) {
+                npc->subscribe(observer);
+            }
+            npcs[i] = std::move(npc);
+        }
+    };
+
+    unsigned threads = spec.threads ? spec.threads : std::max(1u, std::thread::hardware_concurrency());
+    unsigned workers = static_cast<unsigned>(std::min<size_t>(threads, chunks));
+    std::vector<std::thread> pool;
+    for (unsigned t = 1; t < workers; ++t) {
+        pool.emplace_back([&, t]() {
+            for (size_t c = t; c < chunks; c += workers) {
+                fill(c);
+            }
+        });
+    }
+    for (size_t c = 0; c < chunks; c += workers) {
+        fill(c);
+    }
+    for (auto &w : pool) {
+        w.join();
+    }
+
+    sim.spawn(npcs);
+    return npcs.size();
+}
@@ -0,0 +1,346 @@
+#include <gtest/gtest.h>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include "npc.h"
+#include "world.h"
+#include "dragon.h"
+#include "bull.h"
+#include "toad.h"
+#include "simulation.h"
+#include "checkpoint.h"
+#include "renderer.h"
+
+// Нагрузочный прогон полного конвейера main: поток перемещения, несколько FightManager,
+// поток отрисовки и снимки мира. Параметры задаются аргументами после флагов gtest:
+//   --npcs N --seconds S --fight-threads K --flow --baseline FILE --record --gate
+// По умолчанию проверяются только инварианты. Порог производительности - по --gate (или переменной
+// окружения NPC_STRESS_GATE=1) и только в сборке с NDEBUG без санитайзера (NPC_SANITIZE).
+
+namespace {
+    struct StressConfig {
+        int npcs{100000};
+        double seconds{3.0};
+        int fight_threads{4};
+        std::string baseline{STRESS_BASELINE_FILE};
+        bool record{false};
+        bool flow{false};
+        bool gate{false};
+    } config;
+
+    // Допустимая просадка относительно записанного значения: машины и нагрузка на них разные
+    constexpr double BASELINE_TOLERANCE = 0.5;
+
+    // Проверяет, что каждого NPC убили не больше одного раза
+    class KillLedger : public IFightObserver {
+    public:
+        void on_fight(const NPC_ptr &attacker, const NPC_ptr &defender, bool win) override {
+            if (!win) {
+                return;
+            }
+            std::lock_guard<std::mutex> l(mtx);
+            ++kills;
+            if (!attacker->is_alive()) {
+                ++dead_attackers;
+            }
+            if (!killed.insert(defender.get()).second) {
+                ++double_kills;
+            }
+        }
+
+        std::mutex mtx;
+        std::unordered_set<const NPC *> killed;
+        size_t kills{0};
+        size_t double_kills{0};
+        size_t dead_attackers{0};
+    };
+
+    // Без TextObserver и FileObserver, которые подписывает factory: печать убийств исказила бы замер
+    NPC_ptr make_npc(int kind, const std::string &name, int x, int y) {
+        switch (kind) {
+            case DragonType: return std::make_shared<Dragon>(name, x, y);
+            case BullType: return std::make_shared<Bull>(name, x, y);
+            default: return std::make_shared<Toad>(name, x, y);
+        }
+    }
+
+    // Файл порогов: строка "число_NPC NPC-тиков/с" на каждый записанный размер мира
+    std::map<int, uint64_t> read_baseline(const std::string &path) {
+        std::map<int, uint64_t> baseline;
+        std::ifstream in(path);
+        int npcs;
+        uint64_t value;
+        while (in >> npcs >> value) {
+            baseline[npcs] = value;
+        }
+        return baseline;
+    }
+
+    void write_baseline(const std::string &path, const std::map<int, uint64_t> &baseline) {
+        std::ofstream out(path);
+        for (auto [npcs, value] : baseline) {
+            out << npcs << " " << value << "\n";
+        }
+    }
+}
+
+TEST(StressTest, PipelineInvariants) {
+    // Плотность как в main: 50 NPC на поле 100x100
+    const int side = std::max(100, static_cast<int>(std::sqrt(config.npcs / 0.005)));
+    Simulation sim(side, side, 12345);
+    sim.print_kills = false;
+    sim.set_flow(config.flow);
+
+    auto ledger = std::make_shared<KillLedger>();
+    std::vector<NPC_ptr> all;
+    all.reserve(config.npcs);
+    std::mt19937 rng(777);
+    std::uniform_int_distribution<int> kind(1, 3);
+    std::uniform_int_distribution<int> coord(0, side - 1);
+    for (int i = 0; i < config.npcs; ++i) {
+        auto npc = make_npc(kind(rng), "npc_" + std::to_string(i), coord(rng), coord(rng));
+        npc->subscribe(ledger);
+        all.push_back(npc);
+        sim.spawn(npc);
+    }
+    World &world = sim.world();
+    ASSERT_EQ(world.alive(), static_cast<uint32_t>(config.npcs));
+    {
+        auto lock = world.read_lock();
+        std::cout << "[ STRESS   ] " << sim.memory_report() << std::endl;
+    }
+
+    std::atomic_bool running{true};
+    std::atomic_bool moving{true};
+    std::vector<std::unique_ptr<FightManager>> managers;
+    std::vector<std::thread> fight_threads;
+    for (int i = 0; i < config.fight_threads; ++i) {
+        managers.push_back(std::make_unique<FightManager>(sim, running));
+    }
+    for (auto &m : managers) {
+        fight_threads.emplace_back(std::ref(*m));
+    }
+
+    std::atomic<uint64_t> npc_ticks{0};
+    std::atomic<uint64_t> ticks{0};
+    std::atomic<uint64_t> resumed{0};
+    std::string checkpoint_path = ::testing::TempDir() + "stress_checkpoint.bin";
+    std::thread move_thread([&] {
+        Checkpointer checkpointer(checkpoint_path);
+        WorldSnapshot snapshot;
+        std::vector<FightEvent> batch;
+        for (size_t round = 0; moving; ++round) {
+            npc_ticks += world.size();
+            sim.move_tick(batch);
+            resumed += sim.resumed();
+            FightManager &manager = *managers[round % managers.size()];
+            manager.add_events(batch);
+            if (round % 8 == 7) {
+                sim.capture(snapshot, &manager);
+                checkpointer.submit(snapshot, 0);
+            }
+            ++ticks;
+        }
+        checkpointer.flush();
+    });
+
+    // Поток отрисовки и проверки: воскресших нет, координаты в пределах поля, счётчики сходятся
+    std::atomic<size_t> resurrected{0};
+    std::atomic<size_t> out_of_bounds{0};
+    std::atomic<size_t> frames{0};
+    std::thread render_thread([&] {
+        MapRenderer renderer(20, 20);
+        renderer.set_viewport(0, 0, side, side);
+        std::unordered_map<const NPC *, bool> seen_dead;
+        while (running) {
+            renderer.begin_frame();
+            {
+                auto lock = world.read_lock();
+                for (size_t n = 0; n < world.size(); ++n) {
+                    NPC *npc = world.at(n);
+                    auto [x, y] = npc->position();
+                    if (x < 0 || y < 0 || x >= sim.max_x() || y >= sim.max_y()) {
+                        ++out_of_bounds;
+                    }
+                    if (npc->is_alive()) {
+                        renderer.plot(x, y, 'x');
+                    }
+                }
+            }
+            for (auto &npc : all) {
+                bool alive = npc->is_alive();
+                if (seen_dead[npc.get()] && alive) {
+                    ++resurrected;
+                }
+                seen_dead[npc.get()] = !alive;
+            }
+            renderer.compose();
+            ++frames;
+        }
+    });
+
+    auto start = std::chrono::steady_clock::now();
+    std::this_thread::sleep_for(std::chrono::duration<double>(config.seconds));
+    moving = false;
+    move_thread.join();
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    running = false;
+    for (auto &t : fight_threads) {
+        t.join();
+    }
+    render_thread.join();
+    std::remove(checkpoint_path.c_str());
+
+    EXPECT_EQ(resurrected.load(), 0u);
+    EXPECT_EQ(out_of_bounds.load(), 0u);
+    EXPECT_GT(frames.load(), 0u);
+    EXPECT_EQ(ledger->double_kills, 0u);
+    EXPECT_EQ(ledger->dead_attackers, 0u);
+    EXPECT_EQ(ledger->kills + world.alive(), static_cast<size_t>(config.npcs));
+
+    size_t alive = 0;
+    for (auto &npc : all) {
+        alive += npc->is_alive();
+    }
+    EXPECT_EQ(alive, world.alive());
+    for (int k = 1; k <= 3; ++k) {
+        size_t by_kind = 0;
+        for (auto &npc : all) {
+            by_kind += npc->is_alive() && npc->kind() == k;
+        }
+        EXPECT_EQ(by_kind, world.population(k)) << "kind " << k;
+    }
+
+    double throughput = npc_ticks / elapsed;
+    std::cout << "[ STRESS   ] " << config.npcs << " NPCs, " << ticks << " ticks in " << elapsed << " s, "
+              << static_cast<uint64_t>(throughput) << " NPC-ticks/s, "
+              << (ticks ? resumed / ticks : 0) << " moves/tick, " << ledger->kills << " kills, "
+              << frames << " frames" << std::endl;
+
+    // Пороги записаны для случайного блуждания; в режиме полей направлений только инварианты
+    if (config.flow) {
+        return;
+    }
+    auto baseline = read_baseline(config.baseline);
+    if (config.record) {
+        baseline[config.npcs] = static_cast<uint64_t>(throughput);
+        write_baseline(config.baseline, baseline);
+        return;
+    }
+    if (!config.gate) {
+        return;
+    }
+#if defined(NDEBUG) && !defined(NPC_SANITIZED)
+    if (auto it = baseline.find(config.npcs); it != baseline.end()) {
+        EXPECT_GE(throughput, it->second * BASELINE_TOLERANCE)
+            << "throughput dropped below the recorded baseline " << it->second << " NPC-ticks/s";
+    }
+#else
+    std::cout << "[ STRESS   ] throughput gate skipped: baselines are recorded for Release builds without sanitizers"
+              << std::endl;
+#endif
+}
+
+TEST(StressTest, ConcurrentSpawnAndCollect) {
+    World world;
+    std::atomic_bool running{true};
+    std::atomic<size_t> stale_hits{0};
+    std::atomic<size_t> scanned{0};
+    std::vector<EntityId> released;
+    std::mutex released_mtx;
+
+    // Писатель добавляет и убивает NPC, читатели проверяют, что старые id не находятся
+    std::thread writer([&] {
+        for (int round = 0; round < 2000; ++round) {
+            std::vector<EntityId> ids;
+            std::vector<NPC_ptr> npcs;
+            for (int i = 0; i < 50; ++i) {
+                npcs.push_back(make_npc(1 + i % 3, "n", 0, 0));
+                ids.push_back(world.spawn(npcs.back()));
+            }
+            for (int i = 0; i < 50; i += 2) {
+                npcs[i]->must_die();
+            }
+            world.collect();
+            std::lock_guard<std::mutex> l(released_mtx);
+            for (int i = 0; i < 50; i += 2) {
+                released.push_back(ids[i]);
+            }
+            for (int i = 1; i < 50; i += 2) {
+                world.release(ids[i]);
+                released.push_back(ids[i]);
+            }
+        }
+        running = false;
+    });
+
+    std::vector<std::thread> readers;
+    for (int r = 0; r < 4; ++r) {
+        readers.emplace_back([&] {
+            while (running) {
+                std::vector<EntityId> sample;
+                {
+                    std::lock_guard<std::mutex> l(released_mtx);
+                    size_t from = released.size() > 64 ? released.size() - 64 : 0;
+                    sample.assign(released.begin() + from, released.end());
+                }
+                auto lock = world.read_lock();
+                for (EntityId id : sample) {
+                    stale_hits += world.get(id) != nullptr;
+                }
+                for (size_t n = 0; n < world.size(); ++n) {
+                    scanned += world.at(n)->is_alive();
+                }
+            }
+        });
+    }
+
+    writer.join();
+    for (auto &t : readers) {
+        t.join();
+    }
+    EXPECT_EQ(stale_hits.load(), 0u);
+    EXPECT_EQ(world.size(), 0u);
+    EXPECT_EQ(world.alive(), 0u);
+}
+
+int main(int argc, char **argv) {
+    testing::InitGoogleTest(&argc, argv);
+    for (int a = 1; a < argc; ++a) {
+        std::string arg = argv[a];
+        if (arg == "--npcs" && a + 1 < argc) {
+            config.npcs = std::stoi(argv[++a]);
+        } else if (arg == "--seconds" && a + 1 < argc) {
+            config.seconds = std::stod(argv[++a]);
+        } else if (arg == "--fight-threads" && a + 1 < argc) {
+            config.fight_threads = std::max(1, std::stoi(argv[++a]));
+        } else if (arg == "--baseline" && a + 1 < argc) {
+            config.baseline = argv[++a];
+        } else if (arg == "--flow") {
+            config.flow = true;
+        } else if (arg == "--record") {
+            config.record = true;
+        } else if (arg == "--gate") {
+            config.gate = true;
+        } else {
+            std::cerr << "Usage: " << argv[0] << " [gtest flags] [--npcs N] [--seconds S] [--fight-threads K] [--flow]"
+                      << " [--baseline FILE] [--record] [--gate]\n";
+            return 1;
+        }
+    }
+    if (const char *gate = std::getenv("NPC_STRESS_GATE"); gate && *gate && std::string(gate) != "0") {
+        config.gate = true;
+    }
+    return RUN_ALL_TESTS();
+}
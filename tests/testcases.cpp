@@ -3,15 +3,44 @@
 #include <sstream>
 #include <thread>
 #include <chrono>
+#include <random>
+#include <fstream>
+#include <tuple>
+#include <unistd.h>
 #include "npc.h"
 #include "dragon.h"
 #include "bull.h"
 #include "toad.h"
 #include "factory.h"
 #include "observer.h"
+#include "world.h"
+#include "visitor.h"
+#include "proximity.h"
+#include "scheduler.h"
+#include "simulation.h"
+#include "checkpoint.h"
+#include "renderer.h"
+#include "kind_registry.h"
+#include "creature.h"
+#include "spatial_index.h"
+#include "flow_field.h"
+#include "replay.h"
+#include "world_gen.h"
+#include "tick_clock.h"
+#include "dice.h"
+#include "batch.h"
+#include "frame_writer.h"
+#include "locality.h"
+#include "event_log.h"
 
 using namespace std::chrono_literals;
 
+// Имя "<prefix><i>". Не "N" + std::to_string(i): на такой конкатенации GCC 12 в Release даёт ложный -Wrestrict
+std::string numbered(std::string prefix, int i) {
+    prefix.append(std::to_string(i));
+    return prefix;
+}
+
 TEST(FactoryTest, CreateDragon) {
     auto dragon = factory(DragonType, "TestDragon", 10, 20);
     ASSERT_NE(dragon, nullptr);
@@ -477,7 +506,7 @@ TEST(EdgeCaseTest, DeadNPCInteraction) {
     EXPECT_FALSE(bull->is_alive());
     EXPECT_TRUE(dragon->is_close(bull, 10));
 
-    bool can_kill = bull->accept(dragon);
+    [[maybe_unused]] bool can_kill = bull->accept(dragon);
 }
 
 TEST(ComboTest, MultipleNPCsDifferentTypes) {
@@ -508,7 +537,1478 @@ TEST(ComboTest, MultipleNPCsDifferentTypes) {
     }
 }
 
+TEST(WorldTest, SpawnAndGet) {
+    World world;
+    auto dragon = factory(DragonType, "Dragon1", 10, 20);
+    EntityId id = world.spawn(dragon);
+    EXPECT_TRUE(id.valid());
+    EXPECT_EQ(world.size(), 1u);
+    EXPECT_EQ(world.get(id), dragon.get());
+    EXPECT_EQ(world.shared(id), dragon);
+    EXPECT_EQ(world.id_at(0), id);
+}
+
+TEST(WorldTest, StaleIdAfterCollect) {
+    World world;
+    auto bull = factory(BullType, "Bull1", 0, 0);
+    auto toad = factory(ToadType, "Toad1", 0, 0);
+    EntityId bull_id = world.spawn(bull);
+    EntityId toad_id = world.spawn(toad);
+
+    bull->must_die();
+    EXPECT_EQ(world.collect(), 1u);
+    EXPECT_EQ(world.size(), 1u);
+    EXPECT_EQ(world.get(bull_id), nullptr);
+    EXPECT_EQ(world.shared(bull_id), nullptr);
+    EXPECT_EQ(world.get(toad_id), toad.get());
+}
+
+TEST(WorldTest, RecycledSlotGetsNewGeneration) {
+    World world;
+    EntityId old_id = world.spawn(factory(DragonType, "Dragon1", 0, 0));
+    world.release(old_id);
+
+    auto bull = factory(BullType, "Bull1", 0, 0);
+    EntityId new_id = world.spawn(bull);
+    EXPECT_EQ(new_id.index, old_id.index);
+    EXPECT_NE(new_id.generation, old_id.generation);
+    EXPECT_EQ(world.get(old_id), nullptr);
+    EXPECT_EQ(world.get(new_id), bull.get());
+
+    world.release(old_id);
+    EXPECT_EQ(world.get(new_id), bull.get());
+}
+
+TEST(WorldTest, KindTagAndPopulation) {
+    World world;
+    auto dragon = factory(DragonType, "Dragon1", 0, 0);
+    auto bull = factory(BullType, "Bull1", 0, 0);
+    auto toad = factory(ToadType, "Toad1", 0, 0);
+    EXPECT_EQ(dragon->kind(), DragonType);
+    EXPECT_EQ(bull->kind(), BullType);
+    EXPECT_EQ(std::make_shared<Toad>()->kind(), ToadType);
+
+    world.spawn(dragon);
+    world.spawn(bull);
+    EntityId toad_id = world.spawn(toad);
+    EXPECT_EQ(world.kind_at(1), BullType);
+    EXPECT_EQ(world.alive(), 3u);
+    EXPECT_EQ(world.population(BullType), 1u);
+
+    bull->must_die();
+    bull->must_die();
+    EXPECT_EQ(world.population(BullType), 0u);
+    EXPECT_EQ(world.alive(), 2u);
+    world.collect();
+    EXPECT_EQ(world.alive(), 2u);
+
+    world.release(toad_id);
+    EXPECT_EQ(world.population(ToadType), 0u);
+    toad->must_die();
+    EXPECT_EQ(world.population(DragonType), 1u);
+    EXPECT_EQ(world.alive(), 1u);
+}
+
+TEST(WorldTest, HotStoreMirrorsNpcs) {
+    World world;
+    std::vector<NPC_ptr> npcs;
+    std::vector<EntityId> ids;
+    // Достаточно NPC, чтобы горячий массив несколько раз переехал
+    for (int i = 0; i < 100; ++i) {
+        npcs.push_back(factory(i % 2 ? BullType : ToadType, numbered("N", i), i, 2 * i));
+        ids.push_back(world.spawn(npcs.back()));
+    }
+    npcs[3]->move(5, -1, 500, 500);
+    npcs[7]->must_die();
+    world.release(ids[0]);
+    world.collect();
+
+    ASSERT_EQ(world.hot_view().size(), world.size());
+    for (size_t i = 0; i < world.size(); ++i) {
+        const NPC *npc = world.at(i);
+        const PackedNpc &hot = world.hot_at(i);
+        EXPECT_EQ(hot.x, npc->x);
+        EXPECT_EQ(hot.y, npc->y);
+        EXPECT_EQ(hot.kind, npc->kind());
+        EXPECT_EQ(world.alive_at(i), npc->is_alive());
+    }
+    EXPECT_EQ(world.size(), 98u);
+
+    // NPC, покинувший мир, больше не пишет в его массив
+    npcs[0]->move(1, 1, 500, 500);
+    npcs[0]->must_die();
+    EXPECT_EQ(world.alive(), 98u);
+}
+
+TEST(WorldTest, MemoryReport) {
+    World world;
+    for (int i = 0; i < 1000; ++i) {
+        world.spawn(factory(DragonType, numbered("D", i), i, i));
+    }
+    auto lock = world.read_lock();
+    MemoryReport report = world.memory_report();
+    EXPECT_EQ(report.npcs, 1000u);
+    EXPECT_LE(sizeof(PackedNpc), 16u);
+    EXPECT_LE(report.hot_per_npc(), 2.0 * sizeof(PackedNpc));
+    EXPECT_GE(report.object_bytes, 1000 * sizeof(Dragon));
+    EXPECT_GT(report.bytes_per_npc(), report.hot_per_npc());
+    EXPECT_DOUBLE_EQ(report.projected_bytes(10000), 10 * report.bytes_per_npc() * 1000);
+
+    std::ostringstream out;
+    out << report;
+    EXPECT_NE(out.str().find("1000 NPCs"), std::string::npos);
+}
+
+TEST(WorldTest, SimulationMemoryReport) {
+    Simulation sim(1000, 1000, 3);
+    for (int i = 0; i < 100; ++i) {
+        sim.spawn(factory(BullType, numbered("B", i), i, i));
+    }
+    auto lock = sim.world().read_lock();
+    MemoryReport world = sim.world().memory_report();
+    MemoryReport report = sim.memory_report();
+    // Кадры корутин перемещения - один блок пула, колесо держит их записи
+    EXPECT_EQ(world.coroutine_bytes, 0u);
+    EXPECT_GE(report.coroutine_bytes, FramePool::FRAMES_PER_SLAB * sizeof(void *));
+    EXPECT_EQ(report.coroutine_bytes, sim.frame_pool().bytes());
+    EXPECT_GE(report.scheduler_bytes, 100 * sizeof(void *));
+    EXPECT_EQ(report.total_bytes(), world.total_bytes() + report.coroutine_bytes + report.scheduler_bytes);
+
+    std::ostringstream out;
+    out << report;
+    EXPECT_NE(out.str().find("coroutine frames"), std::string::npos);
+}
+
+TEST(WorldTest, MortonReorderKeepsIds) {
+    EXPECT_LT(morton_key(1, 0), morton_key(0, 1));
+    EXPECT_LT(morton_key(0, 1), morton_key(1, 1));
+    EXPECT_LT(morton_key(1, 1), morton_key(2, 0));
+    EXPECT_LT(morton_key(-1, 5), morton_key(0, 5));
+
+    World world;
+    std::vector<NPC_ptr> npcs;
+    std::vector<EntityId> ids;
+    std::mt19937 rng(8);
+    std::uniform_int_distribution<int> coord(0, 999);
+    for (int i = 0; i < 500; ++i) {
+        npcs.push_back(factory(static_cast<NpcKind>(i % 3 + 1), numbered("N", i), coord(rng), coord(rng)));
+        ids.push_back(world.spawn(npcs.back()));
+    }
+    npcs[10]->must_die();
+    std::vector<uint32_t> order;
+    {
+        auto lock = world.read_lock();
+        EXPECT_GT(morton_disorder(world), 0.3);
+        morton_order(world, order);
+    }
+    world.reorder(order);
+
+    auto lock = world.read_lock();
+    EXPECT_EQ(morton_disorder(world), 0.0);
+    for (size_t k = 0; k < npcs.size(); ++k) {
+        ASSERT_EQ(world.get(ids[k]), npcs[k].get());
+        size_t i = world.index_of(ids[k]);
+        EXPECT_EQ(world.at(i), npcs[k].get());
+        EXPECT_EQ(world.id_at(i), ids[k]);
+        EXPECT_EQ(world.hot_at(i).x, npcs[k]->x);
+        EXPECT_EQ(world.hot_at(i).y, npcs[k]->y);
+        EXPECT_EQ(world.alive_at(i), npcs[k]->is_alive());
+    }
+    // NPC пишет уже в свою новую запись
+    npcs[0]->move(3, 3, 1000, 1000);
+    EXPECT_EQ(world.hot_at(world.index_of(ids[0])).x, npcs[0]->x);
+}
+
+TEST(WorldTest, SimulationReordersWhenLocalityDegrades) {
+    Simulation sim(1000, 1000, 4);
+    std::mt19937 rng(4);
+    std::uniform_int_distribution<int> coord(0, 999);
+    for (int i = 0; i < 300; ++i) {
+        sim.spawn(create(ToadType, numbered("T", i), coord(rng), coord(rng)));
+    }
+    sim.tick();
+    EXPECT_EQ(sim.reorders(), 1u);
+    {
+        auto lock = sim.world().read_lock();
+        EXPECT_LT(morton_disorder(sim.world()), 0.25);
+    }
+    for (uint64_t t = 1; t < 4 * Simulation::REORDER_CHECK_TICKS; ++t) {
+        sim.tick();
+    }
+    EXPECT_EQ(sim.world().alive(), 300u);
+
+    Simulation off(1000, 1000, 4);
+    off.set_reorder_threshold(0);
+    off.spawn(create(ToadType, "T", 1, 1));
+    off.spawn(create(ToadType, "T", 0, 0));
+    off.tick();
+    EXPECT_EQ(off.reorders(), 0u);
+}
+
+TEST(WorldTest, InvalidId) {
+    World world;
+    EXPECT_FALSE(EntityId{}.valid());
+    EXPECT_EQ(world.get(EntityId{}), nullptr);
+    EXPECT_EQ(world.get(EntityId{5, 0}), nullptr);
+}
+
+TEST(BattleTest, ResolveKillsPrey) {
+    std::vector<NPC_ptr> npcs = {
+        factory(DragonType, "Dragon1", 0, 0),
+        factory(BullType, "Bull1", 3, 4),
+        factory(ToadType, "Toad1", 50, 50)
+    };
+    std::vector<bool> dead = BattleManager::resolve(npcs, 10);
+    EXPECT_FALSE(dead[0]);
+    EXPECT_TRUE(dead[1]);
+    EXPECT_FALSE(dead[2]);
+}
+
+TEST(BattleTest, ParallelMatchesSequential) {
+    std::mt19937 rng(42);
+    std::uniform_int_distribution<int> coord(0, 99);
+    std::uniform_int_distribution<int> kind(1, 3);
+    std::vector<NPC_ptr> npcs;
+    for (int i = 0; i < 400; ++i) {
+        npcs.push_back(factory(static_cast<NpcKind>(kind(rng)), "npc_" + std::to_string(i), coord(rng), coord(rng)));
+    }
+
+    std::vector<bool> sequential = BattleManager::resolve(npcs, 10);
+    for (unsigned threads : {1u, 2u, 4u, 7u}) {
+        EXPECT_EQ(BattleManager::resolve_parallel(npcs, 10, threads), sequential);
+    }
+}
+
+TEST(BattleTest, MassBattleRemovesDead) {
+    std::vector<NPC_ptr> npcs = {
+        factory(BullType, "Bull1", 10, 10),
+        factory(ToadType, "Toad1", 12, 10),
+        factory(ToadType, "Toad2", 90, 90)
+    };
+    BattleManager::mass_battle(npcs, 5, 2);
+    ASSERT_EQ(npcs.size(), 2u);
+    for (auto &npc : npcs) {
+        EXPECT_NE(npc->name, "Toad1");
+    }
+}
+
+TEST(ProximityTest, IntegerRadius) {
+    EXPECT_TRUE(within_radius(0, 0, 6, 8, 10));
+    EXPECT_FALSE(within_radius(0, 0, 6, 8, 9));
+    EXPECT_FALSE(within_radius(0, 0, 11, 0, 10));
+    EXPECT_FALSE(within_radius(0, 0, 0, -11, 10));
+    EXPECT_TRUE(within_reach(0, 0, -6, -8, Reach{10, 100}));
+    EXPECT_FALSE(within_reach(0, 0, -6, -8, Reach{10, 99}));
+    EXPECT_FALSE(within_radius(0, 0, 0, 0, -1));
+
+    // Квадраты радиусов видов посчитаны заранее и следуют за set_params
+    KindRegistry registry;
+    EXPECT_EQ(registry.kill_radius_sq(DragonType), 900);
+    registry.set_params(BullType, registry.step(BullType), 12);
+    EXPECT_EQ(registry.kill_reach(BullType).radius, 12);
+    EXPECT_EQ(registry.kill_radius_sq(BullType), 144);
+    auto bull = factory(BullType, "Bull1", 0, 0);
+    EXPECT_EQ(bull->kill_reach().radius_sq, squared(bull->kill_radius()));
+}
+
+TEST(ProximityTest, HugeDistanceDoesNotOverflow) {
+    auto dragon1 = factory(DragonType, "Dragon1", -2000000000, -2000000000);
+    auto dragon2 = factory(DragonType, "Dragon2", 2000000000, 2000000000);
+    EXPECT_FALSE(dragon1->is_close(dragon2, 1000));
+    EXPECT_TRUE(dragon1->is_close(dragon1, SIZE_MAX));
+}
+
+TEST(ProximityTest, SpanOverload) {
+    auto bull = factory(BullType, "Bull1", 50, 50);
+    std::vector<NPC_ptr> others = {
+        factory(ToadType, "Toad1", 55, 55),
+        factory(ToadType, "Toad2", 70, 50),
+        factory(DragonType, "Dragon1", 50, 60),
+        factory(DragonType, "Dragon2", 0, 0)
+    };
+    std::vector<uint32_t> hits;
+    EXPECT_EQ(bull->is_close(others, 10, hits), 2u);
+    EXPECT_EQ(hits, (std::vector<uint32_t>{0, 2}));
+    for (size_t i = 0; i < others.size(); ++i) {
+        bool expected = std::find(hits.begin(), hits.end(), i) != hits.end();
+        EXPECT_EQ(bull->is_close(others[i], 10), expected);
+    }
+}
+
+Behaviour count_ticks(int &counter, uint32_t period, int limit) {
+    for (int i = 0; i < limit; ++i) {
+        ++counter;
+        co_await wait_ticks(period);
+    }
+}
+
+TEST(SchedulerTest, WaitTicks) {
+    Scheduler scheduler;
+    int fast = 0;
+    int slow = 0;
+    scheduler.spawn(count_ticks(fast, 1, 100));
+    scheduler.spawn(count_ticks(slow, 10, 100));
+
+    for (int i = 0; i < 30; ++i) {
+        scheduler.tick();
+    }
+    EXPECT_EQ(fast, 30);
+    EXPECT_EQ(slow, 3);
+    EXPECT_EQ(scheduler.active(), 2u);
+}
+
+TEST(SchedulerTest, OnlyDueCoroutinesResume) {
+    Scheduler scheduler;
+    std::vector<int> counters(50, 0);
+    for (auto &c : counters) {
+        scheduler.spawn(count_ticks(c, 500, 10));
+    }
+    EXPECT_EQ(scheduler.tick(), 50u);
+    for (int i = 0; i < 499; ++i) {
+        EXPECT_EQ(scheduler.tick(), 0u);
+    }
+    EXPECT_EQ(scheduler.tick(), 50u);
+}
+
+TEST(SchedulerTest, FinishedCoroutinesLeave) {
+    Scheduler scheduler;
+    int counter = 0;
+    scheduler.spawn(count_ticks(counter, 1, 3));
+    for (int i = 0; i < 5; ++i) {
+        scheduler.tick();
+    }
+    EXPECT_EQ(counter, 3);
+    EXPECT_EQ(scheduler.active(), 0u);
+}
+
+Behaviour pooled_ticks(int &counter, int limit) {
+    for (int i = 0; i < limit; ++i) {
+        ++counter;
+        co_await wait_ticks(1);
+    }
+}
+
+TEST(SchedulerTest, FramesComeFromPool) {
+    Scheduler scheduler;
+    std::vector<int> counters(FramePool::FRAMES_PER_SLAB + 1, 0);
+    {
+        FramePool::Scope frames(scheduler.frame_pool());
+        for (auto &c : counters) {
+            scheduler.spawn(pooled_ticks(c, 2));
+        }
+    }
+    EXPECT_EQ(FramePool::current(), nullptr);
+    EXPECT_EQ(scheduler.frame_pool().slabs(), 2u);
+    for (int i = 0; i < 3; ++i) {
+        scheduler.tick();
+    }
+    EXPECT_EQ(scheduler.active(), 0u);
+    EXPECT_EQ(std::count(counters.begin(), counters.end(), 2), static_cast<long>(counters.size()));
+
+    // Освобождённые кадры берутся снова, новых блоков нет; кадр другого размера - из кучи
+    int counter = 0;
+    FramePool::Scope frames(scheduler.frame_pool());
+    for (size_t i = 0; i < counters.size(); ++i) {
+        scheduler.spawn(pooled_ticks(counter, 1));
+    }
+    scheduler.spawn(count_ticks(counter, 1, 1));
+    EXPECT_EQ(scheduler.frame_pool().slabs(), 2u);
+    scheduler.tick();
+    EXPECT_EQ(counter, static_cast<int>(counters.size()) + 1);
+}
+
+Behaviour wait_for(Event &event, int &woken) {
+    co_await event;
+    ++woken;
+}
+
+Behaviour wait_close(const NPC_ptr &a, const NPC_ptr &b, int &woken) {
+    co_await wait_until([&]() { return a->is_close(b, a->kill_radius()); }, 2);
+    ++woken;
+}
+
+TEST(SchedulerTest, EventAndCondition) {
+    Scheduler scheduler;
+    Event event;
+    int woken = 0;
+    auto dragon = factory(DragonType, "Dragon1", 0, 0);
+    auto bull = factory(BullType, "Bull1", 90, 90);
+
+    scheduler.spawn(wait_for(event, woken));
+    scheduler.spawn(wait_close(dragon, bull, woken));
+    for (int i = 0; i < 5; ++i) {
+        scheduler.tick();
+    }
+    EXPECT_EQ(woken, 0);
+
+    event.signal();
+    scheduler.tick();
+    EXPECT_EQ(woken, 1);
+
+    dragon->move(80, 80, 100, 100);
+    scheduler.tick();
+    scheduler.tick();
+    EXPECT_EQ(woken, 2);
+    EXPECT_EQ(scheduler.active(), 0u);
+}
+
+std::unique_ptr<Simulation> make_simulation(uint32_t seed, int count) {
+    auto sim = std::make_unique<Simulation>(100, 100, seed);
+    sim->print_kills = false;
+    std::mt19937 rng(seed);
+    std::uniform_int_distribution<int> coord(0, 99);
+    std::uniform_int_distribution<int> kind(1, 3);
+    for (int i = 0; i < count; ++i) {
+        sim->spawn(factory(static_cast<NpcKind>(kind(rng)), "npc_" + std::to_string(i), coord(rng), coord(rng)));
+    }
+    return sim;
+}
+
+std::vector<std::tuple<std::string, int, int, bool>> world_state(Simulation &sim) {
+    std::vector<std::tuple<std::string, int, int, bool>> state;
+    World &world = sim.world();
+    for (size_t i = 0; i < world.size(); ++i) {
+        auto [x, y] = world.at(i)->position();
+        state.emplace_back(world.at(i)->name, x, y, world.at(i)->is_alive());
+    }
+    return state;
+}
+
+TEST(SimulationTest, SameSeedSameOutcome) {
+    auto a = make_simulation(7, 60);
+    auto b = make_simulation(7, 60);
+    for (int i = 0; i < 100; ++i) {
+        a->tick();
+        b->tick();
+    }
+    EXPECT_EQ(a->ticks(), 100u);
+    EXPECT_EQ(world_state(*a), world_state(*b));
+}
+
+TEST(SimulationTest, IdleKindsSleepUntilCounterpartsAppear) {
+    // Без быков ни у драконов, ни у жаб нет ни жертв, ни угроз
+    Simulation sim(1000, 1000, 5);
+    sim.print_kills = false;
+    for (int i = 0; i < 20; ++i) {
+        sim.spawn(factory(i % 2 ? DragonType : ToadType, "npc_" + std::to_string(i), i * 5, 50));
+    }
+    sim.tick();
+    EXPECT_EQ(sim.resumed(), 20u);
+    auto frozen = world_state(sim);
+    for (int i = 0; i < 40; ++i) {
+        sim.tick();
+        EXPECT_EQ(sim.resumed(), 0u);
+    }
+    EXPECT_EQ(world_state(sim), frozen);
+
+    // Бык будит всех не позже чем через IDLE_POLL_TICKS тиков
+    sim.spawn(factory(BullType, "bull", 500, 500));
+    size_t woken = 0;
+    for (uint32_t i = 0; i < Simulation::IDLE_POLL_TICKS; ++i) {
+        sim.tick();
+        woken += sim.resumed();
+    }
+    EXPECT_GE(woken, 21u);
+}
+
+TEST(SimulationTest, FarNpcsSleepSeveralTicks) {
+    Simulation far(10000, 10000, 5);
+    far.spawn(factory(BullType, "bull", 100, 100));
+    far.spawn(factory(ToadType, "toad", 9000, 9000));
+    Simulation near(10000, 10000, 5);
+    near.spawn(factory(BullType, "bull", 100, 100));
+    near.spawn(factory(ToadType, "toad", 105, 105));
+
+    size_t far_resumed = 0;
+    size_t near_resumed = 0;
+    for (int i = 0; i < 80; ++i) {
+        far.tick();
+        near.tick();
+        far_resumed += far.resumed();
+        near_resumed += near.resumed();
+    }
+    EXPECT_LE(far_resumed, 2 * (80 / Simulation::MAX_IDLE_TICKS + 1));
+    EXPECT_GT(near_resumed, far_resumed);
+}
+
+TEST(CheckpointTest, SnapshotRoundTrip) {
+    auto sim = make_simulation(3, 20);
+    // Имя NPC из пакетной генерации строится из вида и serial
+    auto generated = factory(ToadType, "", 5, 5);
+    generated->serial = 42;
+    sim->spawn(generated);
+    for (int i = 0; i < 10; ++i) {
+        sim->tick();
+    }
+    WorldSnapshot snapshot;
+    sim->capture(snapshot);
+    EXPECT_EQ(snapshot.tick, 10u);
+    EXPECT_EQ(snapshot.size(), sim->world().size());
+
+    std::stringstream ss;
+    write_snapshot(ss, snapshot);
+    WorldSnapshot loaded;
+    ASSERT_TRUE(read_snapshot(ss, loaded));
+    EXPECT_EQ(loaded.tick, snapshot.tick);
+    ASSERT_EQ(loaded.size(), snapshot.size());
+    for (size_t i = 0; i < snapshot.size(); ++i) {
+        EXPECT_EQ(loaded.name(i), snapshot.name(i));
+    }
+    EXPECT_EQ(loaded.serials, snapshot.serials);
+    EXPECT_EQ(loaded.kind_prey, snapshot.kind_prey);
+    EXPECT_EQ(loaded.kind_table.size(), KindRegistry::instance().size());
+    EXPECT_EQ(loaded.xs, snapshot.xs);
+    EXPECT_EQ(loaded.ys, snapshot.ys);
+    EXPECT_EQ(loaded.kinds, snapshot.kinds);
+    EXPECT_EQ(loaded.alive, snapshot.alive);
+    EXPECT_EQ(loaded.wake_order, snapshot.wake_order);
+    EXPECT_EQ(loaded.wake_delay, snapshot.wake_delay);
+    EXPECT_EQ(loaded.dice_seed, snapshot.dice_seed);
+}
+
+TEST(CheckpointTest, RestoreContinuesExactly) {
+    auto original = make_simulation(11, 80);
+    for (int i = 0; i < 37; ++i) {
+        original->tick();
+    }
+    WorldSnapshot snapshot;
+    original->capture(snapshot);
+    std::stringstream ss;
+    write_snapshot(ss, snapshot);
+
+    WorldSnapshot loaded;
+    ASSERT_TRUE(read_snapshot(ss, loaded));
+    auto restored = Simulation::restore(loaded);
+    ASSERT_NE(restored, nullptr);
+    restored->print_kills = false;
+    EXPECT_EQ(restored->ticks(), 37u);
+
+    for (int i = 0; i < 200; ++i) {
+        original->tick();
+        restored->tick();
+    }
+    EXPECT_EQ(world_state(*original), world_state(*restored));
+}
+
+TEST(CheckpointTest, ThreadedCaptureKeepsFightQueue) {
+    auto original = make_simulation(17, 300);
+    std::atomic_bool running{true};
+    // Редкий разбор: к снимку в очереди потока сражений копятся пары нескольких тиков
+    FightManager manager(*original, running, 5.0);
+    std::thread fight_thread(std::ref(manager));
+    std::vector<FightEvent> batch;
+    for (int t = 0; t < 40; ++t) {
+        original->move_tick(batch);
+        manager.add_events(batch);
+    }
+    WorldSnapshot snapshot;
+    original->capture(snapshot, &manager);
+    running = false;
+    fight_thread.join();
+    EXPECT_FALSE(snapshot.fights.empty());
+
+    std::stringstream ss;
+    write_snapshot(ss, snapshot);
+    WorldSnapshot loaded;
+    ASSERT_TRUE(read_snapshot(ss, loaded));
+    auto restored = Simulation::restore(loaded);
+    ASSERT_NE(restored, nullptr);
+    restored->print_kills = false;
+    std::vector<FightEvent> queued;
+    restored->take_restored_fights(queued);
+    EXPECT_EQ(queued.size(), snapshot.fights.size());
+    restored->resolve(queued);
+    // Поток сражений разобрал всю очередь после снимка - восстановленный мир после её разбора тот же
+    EXPECT_EQ(world_state(*restored), world_state(*original));
+}
+
+TEST(CheckpointTest, RestoreNeedsSameKindsTable) {
+    auto sim = make_simulation(6, 10);
+    WorldSnapshot snapshot;
+    sim->capture(snapshot);
+    KindRegistry other;
+    other.set_kill(ToadType, DragonType, true);
+    EXPECT_EQ(Simulation::restore(snapshot, other), nullptr);
+    ASSERT_TRUE(other.load_table(snapshot.kind_table, snapshot.kind_prey));
+    EXPECT_FALSE(other.can_kill(ToadType, DragonType));
+    EXPECT_NE(Simulation::restore(snapshot, other), nullptr);
+}
+
+TEST(CheckpointTest, CorruptedInput) {
+    std::stringstream garbage("not a checkpoint");
+    WorldSnapshot snapshot;
+    EXPECT_FALSE(read_snapshot(garbage, snapshot));
+
+    auto sim = make_simulation(5, 10);
+    sim->capture(snapshot);
+    std::stringstream ss;
+    write_snapshot(ss, snapshot);
+    std::string truncated = ss.str().substr(0, ss.str().size() / 2);
+    std::stringstream half(truncated);
+    EXPECT_FALSE(read_snapshot(half, snapshot));
+}
+
+TEST(CheckpointTest, BackgroundWriter) {
+    std::string path = ::testing::TempDir() + "checkpoint_test.dat";
+    auto sim = make_simulation(9, 30);
+    {
+        Checkpointer checkpointer(path);
+        WorldSnapshot snapshot;
+        sim->capture(snapshot);
+        EXPECT_TRUE(checkpointer.submit(snapshot, 0.1));
+        checkpointer.flush();
+        EXPECT_EQ(checkpointer.stats().written, 1u);
+    }
+    std::ifstream in(path, std::ios::binary);
+    WorldSnapshot loaded;
+    ASSERT_TRUE(read_snapshot(in, loaded));
+    EXPECT_EQ(loaded.size(), 30u);
+    std::remove(path.c_str());
+}
+
+TEST(ReplayTest, ThreadedRunReplaysExactly) {
+    auto sim = make_simulation(21, 300);
+    FightTrace trace;
+    sim->record(&trace);
+
+    // Как в main: перемещение и разбор в разных потоках, разбор забирает очередь когда успеет
+    std::atomic_bool running{true};
+    FightManager manager(*sim, running);
+    std::thread fight_thread(std::ref(manager));
+    std::vector<FightEvent> batch;
+    for (int t = 0; t < 150; ++t) {
+        sim->move_tick(batch);
+        manager.add_events(batch);
+        std::this_thread::sleep_for(std::chrono::microseconds(t % 7 * 500));
+    }
+    running = false;
+    fight_thread.join();
+    sim->record(nullptr);
+    EXPECT_EQ(trace.end_tick, 150u);
+    ASSERT_FALSE(trace.resolves.empty());
+
+    std::stringstream ss;
+    write_trace(ss, trace);
+    FightTrace loaded;
+    ASSERT_TRUE(read_trace(ss, loaded));
+    EXPECT_EQ(loaded.resolves.size(), trace.resolves.size());
+
+    Replay replay(loaded);
+    ASSERT_TRUE(replay.valid());
+    ReplayResult result = replay.run();
+    EXPECT_FALSE(result.diverged);
+    EXPECT_EQ(result.ticks, 150u);
+    EXPECT_EQ(result.resolves, trace.resolves.size());
+    EXPECT_EQ(world_state(replay.simulation()), world_state(*sim));
+}
+
+TEST(ReplayTest, StopsAtTickAndReportsDivergence) {
+    auto sim = make_simulation(4, 200);
+    FightTrace trace;
+    sim->record(&trace);
+    for (int t = 0; t < 60; ++t) {
+        sim->tick();
+    }
+    sim->record(nullptr);
+    ASSERT_GT(trace.resolves.size(), 2u);
+
+    Replay partial(trace);
+    EXPECT_EQ(partial.run(25).ticks, 25u);
+    EXPECT_EQ(partial.run().ticks, 60u);
+    EXPECT_EQ(world_state(partial.simulation()), world_state(*sim));
+
+    FightTrace tampered = trace;
+    tampered.resolves[2].kills += 1;
+    Replay replay(tampered);
+    ReplayResult result = replay.run();
+    EXPECT_TRUE(result.diverged);
+    EXPECT_EQ(result.divergence_tick, tampered.resolves[2].tick);
+
+    std::stringstream garbage("not a trace");
+    EXPECT_FALSE(read_trace(garbage, tampered));
+}
+
+TEST(WorldGenTest, SameSeedSameWorldForAnyThreadCount) {
+    WorldSpec spec;
+    spec.count = 150000;
+    spec.seed = 42;
+    Simulation one(500, 300, 1), many(500, 300, 1);
+    spec.threads = 1;
+    EXPECT_EQ(generate_world(one, spec), spec.count);
+    spec.threads = 3;
+    EXPECT_EQ(generate_world(many, spec), spec.count);
+
+    ASSERT_EQ(one.world().size(), many.world().size());
+    for (size_t i = 0; i < one.world().size(); i += 997) {
+        const NPC *a = one.world().at(i);
+        const NPC *b = many.world().at(i);
+        EXPECT_EQ(a->kind(), b->kind());
+        EXPECT_EQ(a->position(), b->position());
+        EXPECT_TRUE(a->x >= 0 && a->x < 500 && a->y >= 0 && a->y < 300);
+    }
+    EXPECT_EQ(one.world().alive(), spec.count);
+    EXPECT_EQ(one.world().population(DragonType) + one.world().population(BullType) + one.world().population(ToadType),
+              spec.count);
+    one.tick();
+    EXPECT_EQ(one.ticks(), 1u);
+}
+
+TEST(WorldGenTest, WeightsLazyNamesAndObservers) {
+    class Counter : public IFightObserver {
+    public:
+        void on_fight(const NPC_ptr &, const NPC_ptr &, bool) override {++fights;}
+        int fights{0};
+    };
+    auto counter = std::make_shared<Counter>();
+    WorldSpec spec;
+    spec.count = 20;
+    spec.weights = {0, 0, 1, 0};
+    spec.observers = {counter};
+    Simulation sim(100, 100, 1);
+    generate_world(sim, spec);
+    EXPECT_EQ(sim.world().population(BullType), 20u);
+
+    const NPC *npc = sim.world().at(5);
+    EXPECT_TRUE(npc->name.empty());
+    EXPECT_EQ(npc->get_name(), "Bull_5");
+    std::ostringstream out;
+    out << *npc;
+    EXPECT_NE(out.str().find("Bull_5"), std::string::npos);
+
+    sim.world().shared_at(0)->fight_notify(sim.world().shared_at(1), true);
+    EXPECT_EQ(counter->fights, 1);
+}
+
+TEST(WorldGenTest, ArenaOutlivesItsCreator) {
+    NpcArena::Owner arena = NpcArena::make();
+    NpcArena &storage = *arena;
+    NPC_ptr dragon = create(storage, DragonType, "D", 1, 2);
+    NPC_ptr bull = create(storage, BullType, "B", 3, 4);
+    ASSERT_TRUE(dragon && bull);
+    // Объекты со счётчиками лежат в одном блоке подряд
+    EXPECT_EQ(storage.blocks(), 1u);
+    auto gap = reinterpret_cast<const std::byte *>(bull.get()) - reinterpret_cast<const std::byte *>(dragon.get());
+    EXPECT_GT(gap, 0);
+    EXPECT_LT(static_cast<size_t>(gap), 2 * sizeof(Dragon) + 64);
+
+    // Создатель отпустил арену - NPC живут дальше и сами её держат
+    arena.reset();
+    std::weak_ptr<NPC> watch = dragon;
+    EXPECT_EQ(dragon->shared_from_this(), dragon);
+    EXPECT_EQ(dragon->get_name(), "D");
+    dragon.reset();
+    EXPECT_TRUE(watch.expired());
+    EXPECT_EQ(bull->position(), std::make_pair(3, 4));
+}
+
+TEST(TickClockTest, SleepsOnlyTheRemainingBudget) {
+    TickClock clock(200.0);
+    EXPECT_NEAR(clock.rate(), 200.0, 1e-6);
+    auto start = std::chrono::steady_clock::now();
+    clock.start();
+    for (int i = 0; i < 20; ++i) {
+        // Работа в половину бюджета: сон должен быть короче полного периода
+        std::this_thread::sleep_for(std::chrono::microseconds(2500));
+        clock.wait();
+    }
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    EXPECT_GE(ms, 95.0);
+    EXPECT_LT(ms, 300.0);
+    auto stats = clock.stats();
+    EXPECT_EQ(stats.ticks, 20u);
+    EXPECT_GE(stats.work_ms_max, 2.5);
+    EXPECT_GE(stats.jitter_ms_max, 0.0);
+}
+
+TEST(TickClockTest, OverrunsAreCountedAndNotCaughtUp) {
+    TickClock clock(100.0);
+    clock.start();
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    EXPECT_FALSE(clock.wait());
+    EXPECT_TRUE(clock.overloaded());
+    auto stats = clock.stats();
+    EXPECT_EQ(stats.overruns, 1u);
+    EXPECT_GE(stats.skipped, 3u);
+
+    // После пропуска дедлайн считается от текущего момента: следующий тик снова укладывается
+    auto start = std::chrono::steady_clock::now();
+    EXPECT_TRUE(clock.wait());
+    EXPECT_FALSE(clock.overloaded());
+    EXPECT_GE(std::chrono::steady_clock::now() - start, std::chrono::milliseconds(5));
+}
+
+TEST(DiceTest, BatchMatchesSingleRollsAndIsReproducible) {
+    CounterDice dice(12345);
+    std::vector<uint8_t> attack(1000), defense(1000);
+    dice.roll(77, 500, attack, defense);
+    for (uint32_t i = 0; i < attack.size(); ++i) {
+        auto [a, d] = dice.roll(77, 500 + i);
+        ASSERT_EQ(attack[i], a);
+        ASSERT_EQ(defense[i], d);
+        ASSERT_TRUE(a >= 1 && a <= 6 && d >= 1 && d <= 6);
+    }
+    std::vector<uint8_t> again(1000), other(1000), other_def(1000);
+    dice.roll(77, 500, again, other_def);
+    EXPECT_EQ(again, attack);
+    dice.roll(78, 500, other, other_def);
+    EXPECT_NE(other, attack);
+    CounterDice(54321).roll(77, 500, other, other_def);
+    EXPECT_NE(other, attack);
+}
+
+TEST(DiceTest, FacesAreUniform) {
+    constexpr size_t N = 600000;
+    CounterDice dice(7);
+    std::vector<uint8_t> attack(N), defense(N);
+    std::array<size_t, 7> faces{};
+    size_t wins = 0;
+    for (uint64_t tick = 0; tick < 10; ++tick) {
+        dice.roll(tick, 0, std::span(attack).first(N / 10), std::span(defense).first(N / 10));
+        for (size_t i = 0; i < N / 10; ++i) {
+            ++faces[attack[i]];
+            ++faces[defense[i]];
+            wins += attack[i] > defense[i];
+        }
+    }
+    for (int f = 1; f <= 6; ++f) {
+        EXPECT_NEAR(static_cast<double>(faces[f]) / (2 * N), 1.0 / 6, 0.003) << "face " << f;
+    }
+    EXPECT_NEAR(static_cast<double>(wins) / N, 15.0 / 36, 0.003);
+}
+
+TEST(BatchTest, ExpandVariations) {
+    KindRegistry kinds;
+    std::vector<BatchConfig> configs;
+    ASSERT_TRUE(expand_configs(kinds, {}, configs));
+    ASSERT_EQ(configs.size(), 1u);
+    EXPECT_EQ(configs[0].label, "base");
+
+    ASSERT_TRUE(expand_configs(kinds, {"Dragon.step=10,20,30", "Bull.radius=7,9"}, configs));
+    ASSERT_EQ(configs.size(), 6u);
+    EXPECT_EQ(configs[5].label, "Dragon.step=30 Bull.radius=9");
+    EXPECT_EQ(configs[5].kinds.step(DragonType), 30);
+    EXPECT_EQ(configs[5].kinds.kill_radius(BullType), 9);
+    EXPECT_EQ(configs[5].kinds.kill_radius(DragonType), kinds.kill_radius(DragonType));
+
+    EXPECT_FALSE(expand_configs(kinds, {"Wyvern.step=1"}, configs));
+    EXPECT_FALSE(expand_configs(kinds, {"Dragon.speed=1"}, configs));
+    EXPECT_FALSE(expand_configs(kinds, {"Dragon.step=1,x"}, configs));
+}
+
+TEST(BatchTest, RunsAreIndependentOfThreadCount) {
+    KindRegistry kinds;
+    std::vector<BatchConfig> configs;
+    ASSERT_TRUE(expand_configs(kinds, {"Bull.radius=1,30"}, configs));
+    BatchOptions options;
+    options.worlds = 3;
+    options.npcs = 60;
+    options.ticks = 200;
+    options.threads = 1;
+    auto serial = run_batch(configs, options);
+    options.threads = 4;
+    auto parallel = run_batch(configs, options);
+
+    ASSERT_EQ(serial.size(), 6u);
+    for (size_t r = 0; r < serial.size(); ++r) {
+        EXPECT_EQ(serial[r].config, parallel[r].config);
+        EXPECT_EQ(serial[r].seed, parallel[r].seed);
+        EXPECT_EQ(serial[r].ticks, parallel[r].ticks);
+        EXPECT_EQ(serial[r].survivors, parallel[r].survivors);
+        EXPECT_LE(serial[r].ticks, 200u);
+    }
+    // Драконов никто не убивает - их число в мире с тем же seed не зависит от конфигурации
+    EXPECT_EQ(serial[0].survivors[DragonType], serial[3].survivors[DragonType]);
+
+    std::ostringstream csv, summary;
+    write_csv(csv, configs, serial);
+    write_summary(summary, configs, serial);
+    std::string table = csv.str();
+    EXPECT_EQ(table.substr(0, table.find('\n')), "config,label,seed,ticks,Dragon,Bull,Toad");
+    EXPECT_EQ(std::count(table.begin(), table.end(), '\n'), 7);
+    EXPECT_NE(summary.str().find("Bull.radius=30"), std::string::npos);
+}
+
+TEST(FrameRingTest, ReaderSeesPublishedFrames) {
+    std::string name = "/npc_test_ring_" + std::to_string(getpid());
+    Simulation sim(100, 100, 5);
+    for (int i = 0; i < 30; ++i) {
+        sim.spawn(create(static_cast<NpcKind>(i % 3 + 1), numbered("n", i), i * 3, 100 - i * 3));
+    }
+    FrameWriter writer;
+    ASSERT_TRUE(writer.open(name, 40, 100, 100, KindRegistry::instance(), 4));
+    FrameReader reader;
+    ASSERT_TRUE(reader.open(name));
+    EXPECT_EQ(reader.header().capacity, 40u);
+    EXPECT_STREQ(reader.header().kinds[DragonType].name, "Dragon");
+    EXPECT_EQ(reader.header().kinds[ToadType].glyph, KindRegistry::instance().glyph(ToadType));
+
+    Frame frame;
+    EXPECT_FALSE(reader.next(frame));
+    for (int t = 0; t < 3; ++t) {
+        sim.tick();
+        writer.publish(sim.world(), sim.ticks());
+        ASSERT_TRUE(reader.next(frame));
+        EXPECT_EQ(frame.number, static_cast<uint64_t>(t));
+        EXPECT_EQ(frame.tick, sim.ticks());
+        ASSERT_EQ(frame.records.size(), sim.world().size());
+        EXPECT_FALSE(frame.truncated);
+        for (size_t i = 0; i < frame.records.size(); ++i) {
+            const PackedNpc &hot = sim.world().hot_at(i);
+            EXPECT_EQ(frame.records[i].x, hot.x);
+            EXPECT_EQ(frame.records[i].y, hot.y);
+            EXPECT_EQ(frame.records[i].kind, hot.kind);
+            EXPECT_EQ(frame.records[i].alive, hot.alive);
+            EXPECT_EQ(frame.records[i].id, sim.world().id_at(i).index);
+        }
+    }
+    EXPECT_FALSE(reader.next(frame));
+    EXPECT_FALSE(reader.latest(frame));
+    EXPECT_EQ(reader.lost(), 0u);
+}
+
+TEST(FrameRingTest, SlowReaderLosesOldFramesOnly) {
+    std::string name = "/npc_test_ring_slow_" + std::to_string(getpid());
+    Simulation sim(100, 100, 5);
+    for (int i = 0; i < 10; ++i) {
+        sim.spawn(create(BullType, numbered("b", i), i * 10, i * 10));
+    }
+    FrameWriter writer;
+    ASSERT_TRUE(writer.open(name, 4, 100, 100, KindRegistry::instance(), 4));
+    FrameReader reader;
+    ASSERT_TRUE(reader.open(name));
+
+    for (uint64_t t = 1; t <= 10; ++t) {
+        writer.publish(sim.world(), t);
+    }
+    Frame frame;
+    // Кадры 0-5 перезаписаны, в кольце остались 6-9
+    ASSERT_TRUE(reader.next(frame));
+    EXPECT_EQ(frame.number, 6u);
+    EXPECT_EQ(frame.tick, 7u);
+    EXPECT_EQ(reader.lost(), 6u);
+    EXPECT_TRUE(frame.truncated);
+    EXPECT_EQ(frame.records.size(), 4u);
+
+    ASSERT_TRUE(reader.latest(frame));
+    EXPECT_EQ(frame.tick, 10u);
+    EXPECT_FALSE(reader.next(frame));
+    EXPECT_EQ(reader.lost(), 6u);
+
+    // Читатель, открывший кольцо позже, начинает с самого старого кадра
+    FrameReader late;
+    ASSERT_TRUE(late.open(name));
+    ASSERT_TRUE(late.next(frame));
+    EXPECT_EQ(frame.tick, 7u);
+    EXPECT_FALSE(FrameReader().open(name + "_missing"));
+}
+
+namespace {
+    // Приёмник для тестов: считает, сколько раз до него дошёл готовый текст
+    struct CountingSink : LogSink {
+        CountingSink() : LogSink(LogFormat::Compact) {}
+        size_t written{0};
+        std::string last;
+
+    protected:
+        void write_text(std::string_view text) override {
+            ++written;
+            last = text;
+        }
+    };
+}
+
+TEST(LogTest, RecordsRenderInSinkFormat) {
+    auto dragon = create(DragonType, "Smaug", 3, 4);
+    auto bull = create(BullType, "", 10, -2);
+    bull->serial = 7;
+
+    std::ostringstream detailed, compact;
+    StreamSink console(detailed, LogFormat::Detailed);
+    StreamSink file(compact, LogFormat::Compact, false);
+    LogRecord murder{LogRecord::Murder, dragon.get(), bull.get()};
+    console.submit(murder);
+    file.submit(murder);
+    EXPECT_EQ(detailed.str(), "\nMurder --------\nDargon: { name: Smaug, x: 3, y: 4 }\nBull: { name: Bull_7, x: 10, y: -2 }\n");
+    EXPECT_EQ(compact.str(), "Murder --------\nSmaug vs Bull_7\n");
+
+    detailed.str("");
+    console.submit(LogRecord{LogRecord::Kill, dragon.get(), bull.get(), 12, 6, 2});
+    console.submit(LogRecord{LogRecord::Kill, bull.get(), dragon.get()});
+    EXPECT_EQ(detailed.str(), "Smaug killed Bull_7 (Attack: 6 vs Defense: 2)\nBull_7 killed Smaug\n");
+
+    std::ostringstream line;
+    line << *bull;
+    TextBuffer out;
+    bull->describe(out);
+    EXPECT_EQ(out.view(), "Bull: " + line.str());
+}
+
+TEST(LogTest, FilteredRecordsAreNotRendered) {
+    auto toad = create(ToadType, "T", 0, 0);
+    CountingSink sink;
+    LogRecord kill{LogRecord::Kill, toad.get(), toad.get()};
+
+    TextBuffer::local().clear();
+    sink.set_enabled(false);
+    sink.submit(kill);
+    sink.set_enabled(true);
+    sink.set_types(LogRecord::bit(LogRecord::Murder));
+    sink.submit(kill);
+    EXPECT_EQ(sink.written, 0u);
+    // Отброшенная запись даже не попадала в буфер форматирования
+    EXPECT_EQ(TextBuffer::local().size(), 0u);
+
+    sink.set_types(LogRecord::ALL);
+    sink.submit(kill);
+    EXPECT_EQ(sink.written, 1u);
+    EXPECT_EQ(sink.last, "T killed T\n");
+}
+
+TEST(LogTest, LevelsSamplingAndRateLimit) {
+    auto toad = create(ToadType, "T", 0, 0);
+    LogRecord kill{LogRecord::Kill, toad.get(), toad.get()};
+    LogRecord battle{LogRecord::Battle, toad.get(), toad.get(), 0, 0, 0, LogLevel::Debug};
+
+    CountingSink leveled;
+    leveled.set_level(LogLevel::Info);
+    leveled.submit(battle);
+    leveled.submit(kill);
+    EXPECT_EQ(leveled.written, 1u);
+    leveled.set_level(LogLevel::Off);
+    leveled.submit(kill);
+    EXPECT_EQ(leveled.stats().filtered, 2u);
+    LogLevel level;
+    EXPECT_TRUE(parse_log_level("warning", level));
+    EXPECT_EQ(level, LogLevel::Warning);
+    EXPECT_FALSE(parse_log_level("loud", level));
+
+    // Выборка 1 из 10: около десятой части, итоги тика не прореживаются
+    CountingSink sampled;
+    sampled.set_sampling(10, 3);
+    for (int i = 0; i < 20000; ++i) {
+        sampled.submit(kill);
+    }
+    EXPECT_NEAR(static_cast<double>(sampled.written), 2000.0, 200.0);
+    EXPECT_EQ(sampled.stats().sampled_out, 20000u - sampled.written);
+    KillTally tally;
+    LogRecord summary{LogRecord::Summary};
+    summary.tally = &tally;
+    size_t before = sampled.written;
+    for (int i = 0; i < 10; ++i) {
+        sampled.submit(summary);
+    }
+    EXPECT_EQ(sampled.written, before + 10);
+
+    CountingSink limited;
+    limited.set_rate_limit(5);
+    for (int i = 0; i < 50; ++i) {
+        limited.submit(kill);
+    }
+    EXPECT_EQ(limited.written, 5u);
+    EXPECT_EQ(limited.stats().rate_limited, 45u);
+    std::this_thread::sleep_for(std::chrono::milliseconds(1100));
+    limited.submit(kill);
+    EXPECT_EQ(limited.last, "... 45 messages dropped by rate limit\nT killed T\n");
+}
+
+TEST(LogTest, SimulationSummarizesKillsPerTick) {
+    Simulation sim(100, 100, 3);
+    for (int i = 0; i < 40; ++i) {
+        sim.spawn(create(i % 2 ? DragonType : BullType, numbered("N", i), 50, 50));
+    }
+    sim.summarize_kills = true;
+    std::ostringstream captured;
+    std::streambuf *saved = std::cout.rdbuf(captured.rdbuf());
+    size_t kills = 0;
+    for (int t = 0; t < 5; ++t) {
+        kills += sim.tick();
+    }
+    std::cout.rdbuf(saved);
+
+    ASSERT_GT(kills, 0u);
+    std::string text = captured.str();
+    EXPECT_EQ(text.find(" killed "), std::string::npos);
+    EXPECT_NE(text.find(" kills (Bull "), std::string::npos);
+    EXPECT_EQ(text.rfind("Tick ", 0), 0u);
+}
+
+TEST(RendererTest, FirstFrameIsFull) {
+    MapRenderer renderer(4, 2, 1);
+    renderer.set_viewport(0, 0, 40, 20);
+    renderer.begin_frame();
+    renderer.plot(5, 5, 'D');
+    renderer.set_status(0, "Alive: 1");
+    std::string frame(renderer.compose());
+    EXPECT_NE(frame.find("\x1b[2J"), std::string::npos);
+    EXPECT_NE(frame.find("[D][ ][ ][ ]"), std::string::npos);
+    EXPECT_NE(frame.find("[ ][ ][ ][ ]"), std::string::npos);
+    EXPECT_NE(frame.find("Alive: 1"), std::string::npos);
+}
+
+TEST(RendererTest, UnchangedFrameIsEmpty) {
+    MapRenderer renderer(4, 2, 1);
+    renderer.set_viewport(0, 0, 40, 20);
+    for (int i = 0; i < 2; ++i) {
+        renderer.begin_frame();
+        renderer.plot(5, 5, 'D');
+        renderer.set_status(0, "Alive: 1");
+        renderer.compose();
+    }
+    renderer.begin_frame();
+    renderer.plot(5, 5, 'D');
+    EXPECT_TRUE(renderer.compose().empty());
+}
+
+TEST(RendererTest, OnlyChangedCellsAreWritten) {
+    MapRenderer renderer(4, 2, 1);
+    renderer.set_viewport(0, 0, 40, 20);
+    renderer.begin_frame();
+    renderer.plot(5, 5, 'D');
+    renderer.compose();
+
+    renderer.begin_frame();
+    renderer.plot(35, 15, 'T');
+    std::string frame(renderer.compose());
+    // Клетка (0,0) стирается, клетка (3,1) появляется; курсор сохраняется и восстанавливается
+    EXPECT_EQ(frame, "\x1b" "7" "\x1b[2;2H " "\x1b[3;11HT" "\x1b" "8");
+}
+
+TEST(RendererTest, AdjacentCellsSkipCursorMove) {
+    MapRenderer renderer(4, 1, 0);
+    renderer.set_viewport(0, 0, 4, 1);
+    renderer.begin_frame();
+    renderer.compose();
+
+    renderer.begin_frame();
+    renderer.plot(1, 0, 'B');
+    renderer.plot(2, 0, 'T');
+    EXPECT_EQ(std::string(renderer.compose()), "\x1b" "7" "\x1b[2;5HB][T" "\x1b" "8");
+}
+
+TEST(RendererTest, DensityAndViewport) {
+    MapRenderer renderer(2, 2, 0);
+    renderer.set_viewport(100, 100, 20, 20);
+    renderer.set_density(true);
+    renderer.begin_frame();
+    for (int i = 0; i < 12; ++i) {
+        renderer.plot(101, 101, 'D');
+    }
+    renderer.plot(115, 101, 'B');
+    renderer.plot(5, 5, 'T');
+    renderer.plot(125, 101, 'T');
+    EXPECT_EQ(renderer.count_at(0, 0), 12u);
+    EXPECT_EQ(renderer.count_at(1, 0), 1u);
+    EXPECT_EQ(renderer.count_at(0, 1) + renderer.count_at(1, 1), 0u);
+    std::string frame(renderer.compose());
+    EXPECT_NE(frame.find("[+][1]"), std::string::npos);
+}
+
+TEST(KindRegistryTest, BuiltinKinds) {
+    KindRegistry registry;
+    EXPECT_EQ(registry.size(), 4u);
+    EXPECT_EQ(registry.find("Dragon"), DragonType);
+    EXPECT_EQ(registry.find("Toad"), ToadType);
+    EXPECT_EQ(registry.step(BullType), Bull::STEP);
+    EXPECT_EQ(registry.kill_radius(DragonType), Dragon::KILL_RADIUS);
+    EXPECT_TRUE(registry.can_kill(DragonType, BullType));
+    EXPECT_TRUE(registry.can_kill(BullType, ToadType));
+    EXPECT_FALSE(registry.can_kill(ToadType, DragonType));
+    EXPECT_FALSE(registry.is_predator(ToadType));
+}
+
+TEST(KindRegistryTest, LoadTable) {
+    KindRegistry registry;
+    std::istringstream table(
+        "# новые виды и правила\n"
+        "Wolf W 20 15 Toad Bull\n"
+        "\n"
+        "Toad T 2 5 Wolf  # жаба теперь ест волков\n");
+    ASSERT_TRUE(registry.load(table));
+
+    int wolf = registry.find("Wolf");
+    EXPECT_EQ(wolf, 4);
+    EXPECT_EQ(registry.glyph(wolf), 'W');
+    EXPECT_EQ(registry.step(wolf), 20);
+    EXPECT_TRUE(registry.can_kill(wolf, ToadType));
+    EXPECT_TRUE(registry.can_kill(wolf, BullType));
+    EXPECT_FALSE(registry.can_kill(wolf, DragonType));
+    EXPECT_EQ(registry.step(ToadType), 2);
+    EXPECT_TRUE(registry.is_predator(ToadType));
+    EXPECT_TRUE(registry.can_kill(ToadType, wolf));
+    // Строки, не упомянутые в файле, не меняются
+    EXPECT_TRUE(registry.can_kill(DragonType, BullType));
+}
+
+TEST(KindRegistryTest, RejectsInvalidTable) {
+    KindRegistry registry;
+    std::istringstream bad_line("Wolf W twenty 15\n");
+    EXPECT_FALSE(registry.load(bad_line));
+    std::istringstream unknown_victim("Wolf W 20 15 Unicorn\n");
+    EXPECT_FALSE(registry.load(unknown_victim));
+
+    // Ошибка после уже разобранных строк не меняет таблицу
+    std::istringstream late_error("Wolf W 20 15 Toad\nToad T 2 5\nBull B x 1\n");
+    EXPECT_FALSE(registry.load(late_error));
+    EXPECT_EQ(registry.size(), 4u);
+    EXPECT_EQ(registry.find("Wolf"), 0);
+    EXPECT_EQ(registry.step(ToadType), Toad::STEP);
+    EXPECT_TRUE(registry.can_kill(BullType, ToadType));
+}
+
+TEST(KindRegistryTest, CreatureFightsByTable) {
+    KindRegistry &registry = KindRegistry::instance();
+    int kind = registry.find("Lynx");
+    if (!kind) {
+        std::istringstream table("Lynx L 15 12 Toad\n");
+        ASSERT_TRUE(registry.load(table));
+        kind = registry.find("Lynx");
+    }
+
+    auto lynx = factory(static_cast<NpcKind>(kind), "Lynx1", 0, 0);
+    ASSERT_NE(dynamic_cast<Creature *>(lynx.get()), nullptr);
+    EXPECT_EQ(lynx->kind(), kind);
+    EXPECT_EQ(lynx->kill_radius(), 12);
+
+    auto toad = factory(ToadType, "Toad1", 0, 0);
+    auto dragon = factory(DragonType, "Dragon1", 0, 0);
+    EXPECT_TRUE(toad->accept(lynx));
+    EXPECT_FALSE(dragon->accept(lynx));
+    EXPECT_FALSE(lynx->accept(dragon));
+    EXPECT_FALSE(lynx->accept(toad));
+
+    std::stringstream saved;
+    lynx->save(saved);
+    auto loaded = factory(saved);
+    ASSERT_NE(loaded, nullptr);
+    EXPECT_EQ(loaded->kind(), kind);
+}
+
+void fill_world(World &world, int count, int side, uint32_t seed) {
+    std::mt19937 rng(seed);
+    std::uniform_int_distribution<int> coord(0, side - 1);
+    std::uniform_int_distribution<int> kind(1, 3);
+    for (int i = 0; i < count; ++i) {
+        world.spawn(factory(static_cast<NpcKind>(kind(rng)), "npc_" + std::to_string(i), coord(rng), coord(rng)));
+    }
+}
+
+TEST(SpatialIndexTest, RadiusAndRectMatchBruteForce) {
+    World world;
+    fill_world(world, 2000, 500, 3);
+    world.at(5)->must_die();
+    SpatialIndex index;
+    index.rebuild(world);
+    EXPECT_EQ(index.size(), 1999u);
+
+    std::mt19937 rng(4);
+    std::uniform_int_distribution<int> coord(-50, 550);
+    uint64_t bulls = uint64_t{1} << BullType;
+    for (int q = 0; q < 50; ++q) {
+        int x = coord(rng), y = coord(rng), r = q % 60;
+        std::vector<uint32_t> got, expected, got_rect, expected_rect;
+        index.radius(x, y, r, got, bulls);
+        index.rect(x, y, x + r, y + 2 * r, got_rect);
+        for (uint32_t i = 0; i < world.size(); ++i) {
+            NPC *npc = world.at(i);
+            if (!npc->is_alive()) {
+                continue;
+            }
+            if (world.kind_at(i) == BullType && within_radius(x, y, npc->x, npc->y, r)) {
+                expected.push_back(i);
+            }
+            if (npc->x >= x && npc->x <= x + r && npc->y >= y && npc->y <= y + 2 * r) {
+                expected_rect.push_back(i);
+            }
+        }
+        std::sort(got.begin(), got.end());
+        std::sort(got_rect.begin(), got_rect.end());
+        EXPECT_EQ(got, expected);
+        EXPECT_EQ(got_rect, expected_rect);
+    }
+}
+
+TEST(SpatialIndexTest, NearestMatchesBruteForce) {
+    World world;
+    fill_world(world, 1500, 1000, 5);
+    SpatialIndex index;
+    index.rebuild(world, 16);
+
+    std::mt19937 rng(6);
+    std::uniform_int_distribution<int> coord(0, 999);
+    for (int q = 0; q < 50; ++q) {
+        int x = coord(rng), y = coord(rng);
+        size_t k = 1 + q % 7;
+        uint64_t kinds = q % 2 ? SpatialIndex::ANY_KIND : uint64_t{1} << ToadType;
+        std::vector<uint32_t> got;
+        index.nearest(x, y, k, got, kinds);
+
+        std::vector<std::pair<int64_t, uint32_t>> all;
+        for (uint32_t i = 0; i < world.size(); ++i) {
+            if (kinds >> world.kind_at(i) & 1) {
+                all.emplace_back(squared(world.at(i)->x - x) + squared(world.at(i)->y - y), i);
+            }
+        }
+        std::sort(all.begin(), all.end());
+        std::vector<uint32_t> expected;
+        for (size_t i = 0; i < k; ++i) {
+            expected.push_back(all[i].second);
+        }
+        EXPECT_EQ(got, expected);
+    }
+
+    std::vector<uint32_t> none;
+    index.nearest(0, 0, 3, none, SpatialIndex::ANY_KIND, SpatialIndex::NONE, 0);
+    EXPECT_LE(none.size(), 1u);
+}
+
+TEST(SpatialIndexTest, NearestPreyUsesKillMatrix) {
+    World world;
+    world.spawn(factory(DragonType, "Dragon1", 0, 0));
+    world.spawn(factory(ToadType, "Toad1", 1, 1));
+    world.spawn(factory(BullType, "Bull1", 400, 400));
+    world.spawn(factory(BullType, "Bull2", 50, 50));
+    SpatialIndex index;
+    index.rebuild(world);
+
+    std::vector<uint32_t> prey;
+    index.nearest_prey(world, 0, 5, prey);
+    EXPECT_EQ(prey, (std::vector<uint32_t>{3, 2}));
+    prey.clear();
+    index.nearest_prey(world, 3, 1, prey);
+    EXPECT_EQ(prey, (std::vector<uint32_t>{1}));
+    prey.clear();
+    index.nearest_prey(world, 1, 5, prey);
+    EXPECT_TRUE(prey.empty());
+}
+
+TEST(SpatialIndexTest, CellFollowsWidestRadiusAndKeepsDenseOrder) {
+    World world;
+    fill_world(world, 3000, 800, 7);
+    // Своя таблица: общую другие тесты дополняют видами
+    KindRegistry builtin;
+    SpatialIndex single(builtin);
+    single.rebuild(world);
+    EXPECT_EQ(single.cell_size(), 30);
+    EXPECT_EQ(single.size(), 3000u);
+
+    KindRegistry registry;
+    registry.set_params(ToadType, registry.step(ToadType), 45);
+    SpatialIndex wide(registry);
+    wide.rebuild(world);
+    EXPECT_EQ(wide.cell_size(), 45);
+
+    // Внутри клетки записи идут по возрастанию плотных индексов, в том числе после гибели части NPC
+    World crowd;
+    for (int i = 0; i < 50; ++i) {
+        crowd.spawn(factory(ToadType, numbered("T", i), 7, 7));
+    }
+    crowd.at(10)->must_die();
+    crowd.at(31)->must_die();
+    SpatialIndex index(builtin);
+    index.rebuild(crowd);
+    std::vector<uint32_t> hits;
+    index.radius(7, 7, 0, hits);
+    ASSERT_EQ(hits.size(), 48u);
+    EXPECT_TRUE(std::is_sorted(hits.begin(), hits.end()));
+    EXPECT_EQ(std::count(hits.begin(), hits.end(), 10u) + std::count(hits.begin(), hits.end(), 31u), 0);
+}
+
+TEST(SpatialIndexTest, DetectionMatchesFullScan) {
+    auto sim = make_simulation(11, 400);
+    std::vector<FightEvent> events;
+    for (int t = 0; t < 20; ++t) {
+        events.clear();
+        sim->move_tick(events);
+
+        // Прежний полный перебор пар i < j
+        std::vector<FightEvent> expected;
+        World &world = sim->world();
+        const KindRegistry &kinds = sim->kinds();
+        for (size_t i = 0; i < world.size(); ++i) {
+            for (size_t j = i + 1; j < world.size(); ++j) {
+                NPC *a = world.at(i);
+                NPC *d = world.at(j);
+                if (a->is_alive() && d->is_alive() && kinds.can_kill(world.kind_at(i), world.kind_at(j))
+                    && a->is_close(*d, kinds.kill_radius(world.kind_at(i)))) {
+                    expected.push_back(FightEvent{world.id_at(i), world.id_at(j)});
+                }
+            }
+        }
+        ASSERT_EQ(events.size(), expected.size());
+        for (size_t e = 0; e < events.size(); ++e) {
+            EXPECT_EQ(events[e].attacker, expected[e].attacker);
+            EXPECT_EQ(events[e].defender, expected[e].defender);
+        }
+        sim->resolve(events);
+    }
+}
+
+TEST(FlowFieldTest, DistancesAndDirections) {
+    World world;
+    world.spawn(factory(BullType, "Bull1", 50, 50));
+    world.spawn(factory(ToadType, "Toad1", 20, 50));
+    world.spawn(factory(ToadType, "Toad2", 95, 95));
+    world.spawn(factory(DragonType, "Dragon1", 0, 0));
+    FlowField flow;
+    flow.rebuild(world, 100, 100, 5, 2);
+    EXPECT_EQ(flow.cell_size(), 5);
+    // Поля: жертвы дракона (быки), жертвы быка (жабы), угроза быку (драконы); угроза жабам - те же быки
+    EXPECT_EQ(flow.fields(), 3u);
+
+    EXPECT_EQ(flow.prey_distance(50, 50, BullType), 6);
+    EXPECT_EQ(flow.prey_distance(20, 50, BullType), 0);
+    EXPECT_EQ(flow.threat_distance(20, 50, ToadType), 6);
+    EXPECT_EQ(flow.prey_distance(0, 0, ToadType), FlowField::UNREACHED);
+    EXPECT_EQ(flow.threat_distance(0, 0, DragonType), FlowField::UNREACHED);
+
+    // Бык далеко от дракона - идёт к жабе слева; дракон идёт к быку по диагонали
+    EXPECT_EQ(flow.direction(50, 50, BullType), std::make_pair(-1, 0));
+    EXPECT_EQ(flow.direction(0, 0, DragonType), std::make_pair(1, 1));
+    // Жаба рядом с быком убегает, дальняя жаба стоит на месте
+    EXPECT_EQ(flow.direction(42, 50, ToadType), std::make_pair(-1, 0));
+    EXPECT_EQ(flow.direction(95, 95, ToadType), std::make_pair(0, 0));
+    // Бык у самого дракона убегает, а не идёт к жабам
+    EXPECT_EQ(flow.direction(5, 5, BullType), std::make_pair(1, 1));
+}
+
+TEST(FlowFieldTest, PredatorsCatchUp) {
+    auto chase = [](bool flow) {
+        Simulation sim(300, 300, 21);
+        sim.print_kills = false;
+        sim.set_flow(flow);
+        sim.spawn(factory(BullType, "Bull1", 10, 10));
+        auto toad = factory(ToadType, "Toad1", 250, 250);
+        sim.spawn(toad);
+        int ticks = 0;
+        while (toad->is_alive() && ticks < 500) {
+            sim.tick();
+            ++ticks;
+        }
+        return ticks;
+    };
+    int directed = chase(true);
+    EXPECT_LT(directed, 60);
+    EXPECT_LT(directed, chase(false));
+}
+
+TEST(FlowFieldTest, SameSeedSameOutcome) {
+    auto a = make_simulation(9, 200);
+    auto b = make_simulation(9, 200);
+    a->set_flow(true);
+    b->set_flow(true);
+    // Потоки перестройки полей переживают тики и на исход не влияют
+    a->set_flow_threads(3);
+    b->set_flow_threads(1);
+    for (int i = 0; i < 50; ++i) {
+        a->tick();
+        b->tick();
+    }
+    EXPECT_EQ(world_state(*a), world_state(*b));
+}
+
 int main(int argc, char **argv) {
     testing::InitGoogleTest(&argc, argv);
+    // factory подписывает NPC на FileObserver: журнал тестов - во временном каталоге, а не в текущем
+    FileObserver::set_path(::testing::TempDir() + "npc_tests_log.txt");
     return RUN_ALL_TESTS();
 }
\ No newline at end of file